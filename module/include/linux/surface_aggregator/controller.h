@@ -14,6 +14,7 @@
 
 #include <linux/completion.h>
 #include <linux/device.h>
+#include <linux/mempool.h>
 #include <linux/types.h>
 
 #include "serial_hub.h"
@@ -134,12 +135,20 @@ ssize_t ssam_request_write_data(struct ssam_span *buf,
  * @resp:   Buffer to store the response.
  * @status: Status of the request, set after the base request has been
  *          completed or has failed.
+ * @cache:  Cache the request has been allocated from via
+ *          ssam_request_sync_alloc(), %NULL if it has not been allocated
+ *          from a cache. Private to the allocator.
+ * @pool:   Memory pool the request has been allocated from, %NULL if it has
+ *          not been allocated from a memory pool. Private to the allocator.
  */
 struct ssam_request_sync {
 	struct ssh_request base;
 	struct completion comp;
 	struct ssam_response *resp;
 	int status;
+
+	struct kmem_cache *cache;
+	mempool_t *pool;
 };
 
 int ssam_request_sync_alloc(size_t payload_len, gfp_t flags,
@@ -209,13 +218,18 @@ static inline int ssam_request_sync_wait(struct ssam_request_sync *rqst)
 
 int ssam_request_do_sync(struct ssam_controller *ctrl,
 			 const struct ssam_request *spec,
-			 struct ssam_response *rsp);
+			 struct ssam_response *rsp, gfp_t flags);
 
 int ssam_request_do_sync_with_buffer(struct ssam_controller *ctrl,
 				     const struct ssam_request *spec,
 				     struct ssam_response *rsp,
 				     struct ssam_span *buf);
 
+int ssam_request_batch(struct ssam_controller *ctrl,
+		       const struct ssam_request *specs,
+		       struct ssam_response *rsps, int *status,
+		       unsigned int count);
+
 /**
  * ssam_request_do_sync_onstack - Execute a synchronous request on the stack.
  * @ctrl: The controller via which the request is submitted.
@@ -243,6 +257,71 @@ int ssam_request_do_sync_with_buffer(struct ssam_controller *ctrl,
 		ssam_request_do_sync_with_buffer(ctrl, rqst, rsp, &__buf);	\
 	})
 
+/* -- Asynchronous request interface. --------------------------------------- */
+
+struct ssam_request_async;
+
+/**
+ * typedef ssam_request_async_fn_t - Asynchronous request completion callback.
+ * @rqst:    The request that has been completed.
+ * @data:    The response payload of the request. %NULL if the request has
+ *           failed or does not have a response. Only valid for the duration
+ *           of the callback.
+ * @status:  The status of the request. Zero on success, negative errno on
+ *           failure.
+ * @context: The context provided on submission of the request.
+ *
+ * The callback is usually executed in the context of the transport layer,
+ * e.g. its receiver thread. It may, however, also be executed before
+ * ssam_request_async_submit() returns, in the context of the submitter. This
+ * happens if the request is completed with an error while being passed on
+ * directly to the transport layer, or if it is canceled. The callback must
+ * therefore not block and must not take any locks held by the submitter
+ * while calling ssam_request_async_submit() or ssam_request_async_cancel().
+ */
+typedef void (*ssam_request_async_fn_t)(struct ssam_request_async *rqst,
+					const struct ssam_span *data,
+					int status, void *context);
+
+/**
+ * struct ssam_request_async - Asynchronous SAM request struct.
+ * @base:     Underlying SSH request.
+ * @complete: Callback invoked on completion of the request.
+ * @context:  Context passed to the completion callback.
+ *
+ * The request is reference counted via its underlying SSH request. It is
+ * freed once its last reference has been dropped via
+ * ssam_request_async_put().
+ */
+struct ssam_request_async {
+	struct ssh_request base;
+	ssam_request_async_fn_t complete;
+	void *context;
+};
+
+struct ssam_request_async *
+ssam_request_async_submit(struct ssam_controller *ctrl,
+			  const struct ssam_request *spec,
+			  ssam_request_async_fn_t complete, void *context,
+			  gfp_t flags);
+
+bool ssam_request_async_cancel(struct ssam_request_async *rqst);
+
+/**
+ * ssam_request_async_put - Drop reference to asynchronous request.
+ * @rqst: The request.
+ *
+ * Drops the reference to the request obtained via
+ * ssam_request_async_submit(). The request is freed once it has been
+ * completed and all references to it have been dropped. After this call, the
+ * request must not be accessed any more by the caller, except from within
+ * its completion callback.
+ */
+static inline void ssam_request_async_put(struct ssam_request_async *rqst)
+{
+	ssh_request_put(&rqst->base);
+}
+
 /**
  * __ssam_retry - Retry request in case of I/O errors or timeouts.
  * @request: The request function to execute. Must return an integer.
@@ -778,7 +857,7 @@ typedef u32 (*ssam_notifier_fn_t)(struct ssam_event_notifier *nf,
 /**
  * struct ssam_notifier_block - Base notifier block for SSAM event
  * notifications.
- * @node:     The node for the list of notifiers.
+ * @node:     The node in the notifier dispatch index.
  * @fn:       The callback function of this notifier. This function takes the
  *            respective notifier block and event as input and should return
  *            a notifier value, which can either be obtained from the flags
@@ -789,11 +868,14 @@ typedef u32 (*ssam_notifier_fn_t)(struct ssam_event_notifier *nf,
  *            will be called. A higher value means higher priority, i.e. the
  *            associated callback will be executed earlier than other (lower
  *            priority) callbacks.
+ * @seq:      Registration sequence number, used to order callbacks of equal
+ *            priority. Set on registration.
  */
 struct ssam_notifier_block {
-	struct list_head node;
+	struct hlist_node node;
 	ssam_notifier_fn_t fn;
 	int priority;
+	unsigned long seq;
 };
 
 /**
@@ -486,6 +486,8 @@ struct ssh_packet_ops {
  *            pending lock after first submission.
  * @queue_node:	The list node for the packet queue.
  * @pending_node: The list node for the set of pending packets.
+ * @timeout_node: The list node for the set of pending packets with active
+ *            timeout. Must only be accessed while holding the pending lock.
  * @ops:      Packet operations.
  */
 struct ssh_packet {
@@ -504,6 +506,7 @@ struct ssh_packet {
 
 	struct list_head queue_node;
 	struct list_head pending_node;
+	struct list_head timeout_node;
 
 	const struct ssh_packet_ops *ops;
 };
@@ -604,6 +607,8 @@ struct ssh_request_ops {
  * struct ssh_request - SSH transport request.
  * @packet: The underlying SSH transport packet.
  * @node:   List node for the request queue and pending set.
+ * @hash_node: Hash-table node for looking up the request by its request ID
+ *          while it is pending.
  * @state:  State and type flags describing current request state (dynamic)
  *          and type (static). See &enum ssh_request_flags for possible
  *          options.
@@ -612,14 +617,22 @@ struct ssh_request_ops {
  *          completed and may be %KTIME_MAX before that, or when the request
  *          does not expect a response. Used for the request timeout
  *          implementation.
+ * @submitted: Timestamp specifying when the request has been submitted. Used
+ *          for latency statistics.
+ * @transmitted: Timestamp specifying when the last transmission of the
+ *          underlying packet has been started. Set once the underlying packet
+ *          has been completed. Used for latency statistics.
  * @ops:    Request Operations.
  */
 struct ssh_request {
 	struct ssh_packet packet;
 	struct list_head node;
+	struct hlist_node hash_node;
 
 	unsigned long state;
 	ktime_t timestamp;
+	ktime_t submitted;
+	ktime_t transmitted;
 
 	const struct ssh_request_ops *ops;
 };
@@ -110,10 +110,9 @@ static int ssam_hid_get_descriptor(struct surface_hid_device *shid, u8 entry, u8
 	return 0;
 }
 
-static int ssam_hid_set_raw_report(struct surface_hid_device *shid, u8 rprt_id, bool feature,
-				   u8 *buf, size_t len)
+static void ssam_hid_init_set_report(struct surface_hid_device *shid, struct ssam_request *rqst,
+				     u8 rprt_id, bool feature, u8 *buf, size_t len)
 {
-	struct ssam_request rqst;
 	u8 cid;
 
 	if (feature)
@@ -121,17 +120,52 @@ static int ssam_hid_set_raw_report(struct surface_hid_device *shid, u8 rprt_id,
 	else
 		cid = SURFACE_HID_CID_OUTPUT_REPORT;
 
-	rqst.target_category = shid->uid.category;
-	rqst.target_id = shid->uid.target;
-	rqst.instance_id = shid->uid.instance;
-	rqst.command_id = cid;
-	rqst.flags = 0;
-	rqst.length = len;
-	rqst.payload = buf;
+	rqst->target_category = shid->uid.category;
+	rqst->target_id = shid->uid.target;
+	rqst->instance_id = shid->uid.instance;
+	rqst->command_id = cid;
+	rqst->flags = 0;
+	rqst->length = len;
+	rqst->payload = buf;
 
 	buf[0] = rprt_id;
+}
 
-	return ssam_retry(ssam_request_do_sync, shid->ctrl, &rqst, NULL);
+static int ssam_hid_set_raw_report(struct surface_hid_device *shid, u8 rprt_id, bool feature,
+				   u8 *buf, size_t len)
+{
+	struct ssam_request rqst;
+
+	ssam_hid_init_set_report(shid, &rqst, rprt_id, feature, buf, len);
+	return ssam_retry(ssam_request_do_sync, shid->ctrl, &rqst, NULL, GFP_KERNEL);
+}
+
+static void ssam_hid_set_report_complete(struct ssam_request_async *rqst,
+					 const struct ssam_span *data, int status, void *context)
+{
+	/*
+	 * Nothing to do here: As with other HID transports, errors of
+	 * asynchronous set-report requests are not reported back. Note that
+	 * the device may already be gone, so do not access it.
+	 */
+}
+
+static int ssam_hid_set_raw_report_async(struct surface_hid_device *shid, u8 rprt_id, bool feature,
+					 u8 *buf, size_t len)
+{
+	struct ssam_request_async *r;
+	struct ssam_request rqst;
+
+	ssam_hid_init_set_report(shid, &rqst, rprt_id, feature, buf, len);
+
+	r = ssam_request_async_submit(shid->ctrl, &rqst, ssam_hid_set_report_complete, NULL,
+				      GFP_ATOMIC);
+	if (IS_ERR(r))
+		return PTR_ERR(r);
+
+	/* We do not need the handle. The request is freed once completed. */
+	ssam_request_async_put(r);
+	return 0;
 }
 
 static int ssam_hid_get_raw_report(struct surface_hid_device *shid, u8 rprt_id, u8 *buf, size_t len)
@@ -219,6 +253,7 @@ static int surface_hid_probe(struct ssam_device *sdev)
 	shid->ops.output_report = shid_output_report;
 	shid->ops.get_feature_report = shid_get_feature_report;
 	shid->ops.set_feature_report = shid_set_feature_report;
+	shid->ops.set_report_async = ssam_hid_set_raw_report_async;
 
 	ssam_device_set_drvdata(sdev, shid);
 	return surface_hid_device_add(shid);
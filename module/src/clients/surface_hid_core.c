@@ -174,6 +174,40 @@ static int surface_hid_raw_request(struct hid_device *hid, unsigned char reportn
 	return -EIO;
 }
 
+static void surface_hid_request(struct hid_device *hid, struct hid_report *report, int reqtype)
+{
+	struct surface_hid_device *shid = hid->driver_data;
+	bool feature = report->type == HID_FEATURE_REPORT;
+	u8 *buf;
+	int status;
+
+	if (surface_hid_is_hot_removed(shid))
+		return;
+
+	/*
+	 * Only set-report requests can be submitted without waiting for their
+	 * completion. Handle everything else via the generic (blocking) path.
+	 */
+	if (!shid->ops.set_report_async || reqtype != HID_REQ_SET_REPORT ||
+	    (report->type != HID_OUTPUT_REPORT && !feature)) {
+		__hid_request(hid, report, reqtype);
+		return;
+	}
+
+	/* This may be called from atomic context, e.g. by HID drivers. */
+	buf = hid_alloc_report_buf(report, GFP_ATOMIC);
+	if (!buf)
+		return;
+
+	hid_output_report(report, buf);
+
+	status = shid->ops.set_report_async(shid, report->id, feature, buf, hid_report_len(report));
+	if (status)
+		dev_dbg(shid->dev, "failed to submit report: %d\n", status);
+
+	kfree(buf);
+}
+
 static const struct hid_ll_driver surface_hid_ll_driver = {
 	.start       = surface_hid_start,
 	.stop        = surface_hid_stop,
@@ -181,6 +215,7 @@ static const struct hid_ll_driver surface_hid_ll_driver = {
 	.close       = surface_hid_close,
 	.parse       = surface_hid_parse,
 	.raw_request = surface_hid_raw_request,
+	.request     = surface_hid_request,
 };
 
 
@@ -53,6 +53,8 @@ struct surface_hid_device_ops {
 	int (*output_report)(struct surface_hid_device *shid, u8 rprt_id, u8 *buf, size_t len);
 	int (*get_feature_report)(struct surface_hid_device *shid, u8 rprt_id, u8 *buf, size_t len);
 	int (*set_feature_report)(struct surface_hid_device *shid, u8 rprt_id, u8 *buf, size_t len);
+	int (*set_report_async)(struct surface_hid_device *shid, u8 rprt_id, bool feature, u8 *buf,
+				size_t len);
 };
 
 struct surface_hid_device {
@@ -8,12 +8,16 @@
 #include <linux/acpi.h>
 #include <linux/atomic.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/gpio/consumer.h>
+#include <linux/hash.h>
 #include <linux/interrupt.h>
 #include <linux/kref.h>
 #include <linux/limits.h>
 #include <linux/list.h>
 #include <linux/lockdep.h>
+#include <linux/mempool.h>
+#include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/rculist.h>
 #include <linux/rbtree.h>
@@ -105,6 +109,13 @@ static u16 ssh_rqid_next(struct ssh_rqid_counter *c)
  * that handling of events can be tracked and a warning can be issued in case
  * an event goes unhandled. The idea of that warning is that it should help
  * discover and identify new/currently unimplemented features.
+ *
+ * To avoid running the matching rules of every notifier registered for a
+ * target category on each event, notifiers are additionally indexed by the
+ * target and instance ID they filter on. Notifiers not filtering on either
+ * of those are placed under a wildcard key. Dispatching an event then only
+ * needs to look at the (at most four) chains that can contain matching
+ * notifiers, which are merged by priority to preserve the call order.
  */
 
 /**
@@ -129,6 +140,104 @@ static bool ssam_event_matches_notifier(const struct ssam_event_notifier *n,
 	return match;
 }
 
+/*
+ * Event masks under which notifiers can be indexed, i.e. all combinations of
+ * target and instance filters.
+ */
+static const enum ssam_event_mask ssam_nf_masks[] = {
+	SSAM_EVENT_MASK_STRICT,
+	SSAM_EVENT_MASK_TARGET,
+	SSAM_EVENT_MASK_INSTANCE,
+	SSAM_EVENT_MASK_NONE,
+};
+
+/**
+ * ssam_nf_head_chain() - Get the notifier chain for the given filter.
+ * @nh:   The notifier head.
+ * @mask: The event mask of the notifiers.
+ * @tid:  The target ID to filter on.
+ * @iid:  The instance ID to filter on.
+ *
+ * Computes the index key from the given mask and the IDs covered by it. IDs
+ * not covered by the mask are ignored, so that notifiers not filtering on
+ * them end up under the same key for all events of their target category.
+ *
+ * Return: Returns the chain in which notifiers with the given filter are
+ * stored. Due to hash collisions, this chain may also contain notifiers with
+ * different filters.
+ */
+static struct hlist_head *ssam_nf_head_chain(struct ssam_nf_head *nh,
+					     enum ssam_event_mask mask,
+					     u8 tid, u8 iid)
+{
+	u32 key = (u32)(mask & SSAM_EVENT_MASK_STRICT) << 16;
+
+	if (mask & SSAM_EVENT_MASK_TARGET)
+		key |= (u32)tid << 8;
+
+	if (mask & SSAM_EVENT_MASK_INSTANCE)
+		key |= iid;
+
+	return &nh->index[hash_32(key, SSAM_NF_INDEX_BITS)];
+}
+
+/**
+ * ssam_nfblk_chain() - Get the notifier chain for the given notifier.
+ * @nh: The notifier head.
+ * @n:  The event notifier.
+ */
+static struct hlist_head *ssam_nfblk_chain(struct ssam_nf_head *nh,
+					   const struct ssam_event_notifier *n)
+{
+	return ssam_nf_head_chain(nh, n->event.mask, n->event.reg.target_id,
+				  n->event.id.instance);
+}
+
+/**
+ * ssam_nfblk_before() - Test if a notifier block should be called before
+ * another one.
+ * @a: The first notifier block.
+ * @b: The second notifier block.
+ *
+ * Return: Returns %true if @a has a higher priority than @b or, for equal
+ * priorities, if @a has been registered before @b.
+ */
+static bool ssam_nfblk_before(const struct ssam_notifier_block *a,
+			      const struct ssam_notifier_block *b)
+{
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+
+	return (long)(a->seq - b->seq) < 0;
+}
+
+/**
+ * ssam_nfblk_next() - Find the next notifier matching an event in a chain.
+ * @nh:    The notifier head of the chain.
+ * @node:  The node in the chain at which to start searching.
+ * @event: The event to match.
+ *
+ * Must be called with the SRCU read lock of @nh held.
+ *
+ * Return: Returns the first notifier at or after @node matching the given
+ * event, or %NULL if there is none.
+ */
+static struct ssam_event_notifier *ssam_nfblk_next(struct ssam_nf_head *nh,
+						   struct hlist_node *node,
+						   const struct ssam_event *event)
+{
+	struct ssam_event_notifier *nf;
+
+	for (; node; node = srcu_dereference(hlist_next_rcu(node), &nh->srcu)) {
+		nf = hlist_entry(node, struct ssam_event_notifier, base.node);
+
+		if (ssam_event_matches_notifier(nf, event))
+			return nf;
+	}
+
+	return NULL;
+}
+
 /**
  * ssam_nfblk_call_chain() - Call event notifier callbacks of the given chain.
  * @nh:    The notifier head for which the notifier callbacks should be called.
@@ -147,18 +256,57 @@ static bool ssam_event_matches_notifier(const struct ssam_event_notifier *n,
  */
 static int ssam_nfblk_call_chain(struct ssam_nf_head *nh, struct ssam_event *event)
 {
+	struct ssam_event_notifier *cur[ARRAY_SIZE(ssam_nf_masks)];
+	struct hlist_head *chain[ARRAY_SIZE(ssam_nf_masks)];
 	struct ssam_event_notifier *nf;
-	int ret = 0, idx;
+	struct hlist_node *node;
+	struct hlist_head *h;
+	int ret = 0, idx, n = 0, i, j;
 
-	idx = srcu_read_lock(&nh->srcu);
+	/* Collect candidate chains, skipping duplicates due to collisions. */
+	for (i = 0; i < ARRAY_SIZE(ssam_nf_masks); i++) {
+		h = ssam_nf_head_chain(nh, ssam_nf_masks[i], event->target_id,
+				       event->instance_id);
 
-	list_for_each_entry_rcu(nf, &nh->head, base.node,
-				srcu_read_lock_held(&nh->srcu)) {
-		if (ssam_event_matches_notifier(nf, event)) {
-			ret = (ret & SSAM_NOTIF_STATE_MASK) | nf->base.fn(nf, event);
-			if (ret & SSAM_NOTIF_STOP)
+		for (j = 0; j < n; j++) {
+			if (chain[j] == h)
 				break;
 		}
+
+		if (j == n)
+			chain[n++] = h;
+	}
+
+	idx = srcu_read_lock(&nh->srcu);
+
+	for (i = 0; i < n; i++) {
+		node = srcu_dereference(hlist_first_rcu(chain[i]), &nh->srcu);
+		cur[i] = ssam_nfblk_next(nh, node, event);
+	}
+
+	/* Merge chains, calling notifiers in order of their priority. */
+	for (;;) {
+		j = -1;
+
+		for (i = 0; i < n; i++) {
+			if (!cur[i])
+				continue;
+
+			if (j < 0 || ssam_nfblk_before(&cur[i]->base, &cur[j]->base))
+				j = i;
+		}
+
+		if (j < 0)
+			break;
+
+		nf = cur[j];
+
+		ret = (ret & SSAM_NOTIF_STATE_MASK) | nf->base.fn(nf, event);
+		if (ret & SSAM_NOTIF_STOP)
+			break;
+
+		node = srcu_dereference(hlist_next_rcu(&nf->base.node), &nh->srcu);
+		cur[j] = ssam_nfblk_next(nh, node, event);
 	}
 
 	srcu_read_unlock(&nh->srcu, idx);
@@ -169,7 +317,7 @@ static int ssam_nfblk_call_chain(struct ssam_nf_head *nh, struct ssam_event *eve
  * ssam_nfblk_insert() - Insert a new notifier block into the given notifier
  * list.
  * @nh: The notifier head into which the block should be inserted.
- * @nb: The notifier block to add.
+ * @n:  The event notifier to add.
  *
  * Note: This function must be synchronized by the caller with respect to other
  * insert, find, and/or remove calls by holding ``struct ssam_nf.lock``.
@@ -177,15 +325,14 @@ static int ssam_nfblk_call_chain(struct ssam_nf_head *nh, struct ssam_event *eve
  * Return: Returns zero on success, %-EEXIST if the notifier block has already
  * been registered.
  */
-static int ssam_nfblk_insert(struct ssam_nf_head *nh, struct ssam_notifier_block *nb)
+static int ssam_nfblk_insert(struct ssam_nf_head *nh, struct ssam_event_notifier *n)
 {
-	struct ssam_notifier_block *p;
-	struct list_head *h;
+	struct hlist_head *chain = ssam_nfblk_chain(nh, n);
+	struct ssam_notifier_block *nb = &n->base;
+	struct ssam_notifier_block *p, *last = NULL;
 
 	/* Runs under lock, no need for RCU variant. */
-	list_for_each(h, &nh->head) {
-		p = list_entry(h, struct ssam_notifier_block, node);
-
+	hlist_for_each_entry(p, chain, node) {
 		if (unlikely(p == nb)) {
 			WARN(1, "double register detected");
 			return -EEXIST;
@@ -193,9 +340,19 @@ static int ssam_nfblk_insert(struct ssam_nf_head *nh, struct ssam_notifier_block
 
 		if (nb->priority > p->priority)
 			break;
+
+		last = p;
 	}
 
-	list_add_tail_rcu(&nb->node, h);
+	nb->seq = nh->seq++;
+
+	if (p)
+		hlist_add_before_rcu(&nb->node, &p->node);
+	else if (last)
+		hlist_add_behind_rcu(&nb->node, &last->node);
+	else
+		hlist_add_head_rcu(&nb->node, chain);
+
 	return 0;
 }
 
@@ -204,7 +361,7 @@ static int ssam_nfblk_insert(struct ssam_nf_head *nh, struct ssam_notifier_block
  * notifier head.
  * list.
  * @nh: The notifier head on which to search.
- * @nb: The notifier block to search for.
+ * @n:  The event notifier to search for.
  *
  * Note: This function must be synchronized by the caller with respect to other
  * insert, find, and/or remove calls by holding ``struct ssam_nf.lock``.
@@ -212,13 +369,13 @@ static int ssam_nfblk_insert(struct ssam_nf_head *nh, struct ssam_notifier_block
  * Return: Returns true if the given notifier block is registered on the given
  * notifier head, false otherwise.
  */
-static bool ssam_nfblk_find(struct ssam_nf_head *nh, struct ssam_notifier_block *nb)
+static bool ssam_nfblk_find(struct ssam_nf_head *nh, struct ssam_event_notifier *n)
 {
 	struct ssam_notifier_block *p;
 
 	/* Runs under lock, no need for RCU variant. */
-	list_for_each_entry(p, &nh->head, node) {
-		if (p == nb)
+	hlist_for_each_entry(p, ssam_nfblk_chain(nh, n), node) {
+		if (p == &n->base)
 			return true;
 	}
 
@@ -237,7 +394,7 @@ static bool ssam_nfblk_find(struct ssam_nf_head *nh, struct ssam_notifier_block
  */
 static void ssam_nfblk_remove(struct ssam_notifier_block *nb)
 {
-	list_del_rcu(&nb->node);
+	hlist_del_rcu(&nb->node);
 }
 
 /**
@@ -246,13 +403,16 @@ static void ssam_nfblk_remove(struct ssam_notifier_block *nb)
  */
 static int ssam_nf_head_init(struct ssam_nf_head *nh)
 {
-	int status;
+	int status, i;
 
 	status = init_srcu_struct(&nh->srcu);
 	if (status)
 		return status;
 
-	INIT_LIST_HEAD(&nh->head);
+	nh->seq = 0;
+	for (i = 0; i < ARRAY_SIZE(nh->index); i++)
+		INIT_HLIST_HEAD(&nh->index[i]);
+
 	return 0;
 }
 
@@ -637,7 +797,8 @@ static struct ssam_event_item *ssam_event_item_alloc(size_t len, gfp_t flags)
 }
 
 /**
- * ssam_event_queue_push() - Push an event item to the event queue.
+ * ssam_event_queue_push() - Push an event item to the overflow list of the
+ * event queue.
  * @q:    The event queue.
  * @item: The item to add.
  */
@@ -646,15 +807,17 @@ static void ssam_event_queue_push(struct ssam_event_queue *q,
 {
 	spin_lock(&q->lock);
 	list_add_tail(&item->node, &q->head);
+	atomic_inc(&q->count);
 	spin_unlock(&q->lock);
 }
 
 /**
- * ssam_event_queue_pop() - Pop the next event item from the event queue.
+ * ssam_event_queue_pop() - Pop the next event item from the overflow list of
+ * the event queue.
  * @q: The event queue.
  *
- * Returns and removes the next event item from the queue. Returns %NULL If
- * there is no event item left.
+ * Returns and removes the next event item from the overflow list. Returns
+ * %NULL If there is no event item left.
  */
 static struct ssam_event_item *ssam_event_queue_pop(struct ssam_event_queue *q)
 {
@@ -662,26 +825,110 @@ static struct ssam_event_item *ssam_event_queue_pop(struct ssam_event_queue *q)
 
 	spin_lock(&q->lock);
 	item = list_first_entry_or_null(&q->head, struct ssam_event_item, node);
-	if (item)
+	if (item) {
 		list_del(&item->node);
+		atomic_dec(&q->count);
+	}
 	spin_unlock(&q->lock);
 
 	return item;
 }
 
+/**
+ * ssam_event_ring_push() - Place an event in the event ring of the queue.
+ * @q:    The event queue.
+ * @cmd:  The command of the event.
+ * @data: The payload of the event.
+ * @ts:   The time at which the event has been received.
+ *
+ * Copies the event into the next free slot of the event ring without taking
+ * any locks. Must only be called by the single producer of the queue, i.e.
+ * the receiver.
+ *
+ * To preserve the order of events, this fails as long as there are events
+ * left on the overflow list. It also fails if the event payload does not
+ * fit into a slot or if the ring is full. In all those cases, the event has
+ * to be placed on the overflow list instead.
+ *
+ * Return: Returns %true if the event has been placed in the ring, %false
+ * otherwise.
+ */
+static bool ssam_event_ring_push(struct ssam_event_queue *q,
+				 const struct ssh_command *cmd,
+				 const struct ssam_span *data, ktime_t ts)
+{
+	unsigned int head = q->ring.head;
+	struct ssam_event_slot *slot;
+	struct ssam_event *event;
+
+	if (data->len > SSAM_EVENT_RING_PAYLOAD_LEN)
+		return false;
+
+	if (atomic_read(&q->count))
+		return false;
+
+	/* Pairs with release-store of tail in ssam_event_ring_pop(). */
+	if (head - smp_load_acquire(&q->ring.tail) >= SSAM_EVENT_RING_SIZE)
+		return false;
+
+	slot = &q->ring.slots[head & (SSAM_EVENT_RING_SIZE - 1)];
+	event = (struct ssam_event *)slot->buf;
+
+	slot->rqid = get_unaligned_le16(&cmd->rqid);
+	slot->timestamp = ts;
+	event->target_category = cmd->tc;
+	event->target_id = cmd->sid;
+	event->command_id = cmd->cid;
+	event->instance_id = cmd->iid;
+	event->length = data->len;
+	memcpy(&event->data[0], data->ptr, data->len);
+
+	/* Publish slot. Pairs with acquire-load in ssam_event_ring_peek(). */
+	smp_store_release(&q->ring.head, head + 1);
+	return true;
+}
+
+/**
+ * ssam_event_ring_peek() - Get the next event slot of the event ring.
+ * @q: The event queue.
+ *
+ * Must only be called by the single consumer of the queue, i.e. its work
+ * item. The slot must be released via ssam_event_ring_pop() once it has
+ * been handled.
+ *
+ * Return: Returns the next slot of the ring, or %NULL if the ring is empty.
+ */
+static struct ssam_event_slot *ssam_event_ring_peek(struct ssam_event_queue *q)
+{
+	unsigned int tail = q->ring.tail;
+
+	/* Pairs with release-store of head in ssam_event_ring_push(). */
+	if (tail == smp_load_acquire(&q->ring.head))
+		return NULL;
+
+	return &q->ring.slots[tail & (SSAM_EVENT_RING_SIZE - 1)];
+}
+
+/**
+ * ssam_event_ring_pop() - Release the next event slot of the event ring.
+ * @q: The event queue.
+ */
+static void ssam_event_ring_pop(struct ssam_event_queue *q)
+{
+	/* Pairs with acquire-load of tail in ssam_event_ring_push(). */
+	smp_store_release(&q->ring.tail, q->ring.tail + 1);
+}
+
 /**
  * ssam_event_queue_is_empty() - Check if the event queue is empty.
  * @q: The event queue.
  */
 static bool ssam_event_queue_is_empty(struct ssam_event_queue *q)
 {
-	bool empty;
-
-	spin_lock(&q->lock);
-	empty = list_empty(&q->head);
-	spin_unlock(&q->lock);
+	if (READ_ONCE(q->ring.tail) != smp_load_acquire(&q->ring.head))
+		return false;
 
-	return empty;
+	return !atomic_read(&q->count);
 }
 
 /**
@@ -728,25 +975,52 @@ static bool ssam_cplt_submit(struct ssam_cplt *cplt, struct work_struct *work)
 /**
  * ssam_cplt_submit_event() - Submit an event to the completion system.
  * @cplt: The completion system.
- * @item: The event item to submit.
+ * @cmd:  The command of the event.
+ * @data: The payload of the event.
  *
- * Submits the event to the completion system by queuing it on the event item
- * queue and queuing the respective event queue work item on the completion
- * workqueue, which will eventually complete the event.
+ * Submits the event to the completion system by placing it in the event ring
+ * of the respective event queue, or, if that is not possible, by allocating
+ * an event item for it and queuing that on the overflow list of the queue.
+ * Then queues the event queue work item on the completion workqueue, which
+ * will eventually complete the event. Must only be called from the receiver.
  *
  * Return: Returns zero on success, %-EINVAL if there is no event queue that
- * can handle the given event item.
+ * can handle the given event, or %-ENOMEM if the event had to be queued on
+ * the overflow list but no event item could be allocated for it.
  */
 static int ssam_cplt_submit_event(struct ssam_cplt *cplt,
-				  struct ssam_event_item *item)
+				  const struct ssh_command *cmd,
+				  const struct ssam_span *data)
 {
+	u16 rqid = get_unaligned_le16(&cmd->rqid);
+	ktime_t ts = ktime_get_boottime();
 	struct ssam_event_queue *evq;
+	struct ssam_event_item *item;
 
-	evq = ssam_cplt_get_event_queue(cplt, item->event.target_id, item->rqid);
+	evq = ssam_cplt_get_event_queue(cplt, cmd->sid, rqid);
 	if (!evq)
 		return -EINVAL;
 
-	ssam_event_queue_push(evq, item);
+	if (!ssam_event_ring_push(evq, cmd, data, ts)) {
+		atomic_long_inc(&cplt->event.overflow);
+
+		item = ssam_event_item_alloc(data->len, GFP_KERNEL);
+		if (!item) {
+			atomic_long_inc(&cplt->event.dropped);
+			return -ENOMEM;
+		}
+
+		item->rqid = rqid;
+		item->timestamp = ts;
+		item->event.target_category = cmd->tc;
+		item->event.target_id = cmd->sid;
+		item->event.command_id = cmd->cid;
+		item->event.instance_id = cmd->iid;
+		memcpy(&item->event.data[0], data->ptr, data->len);
+
+		ssam_event_queue_push(evq, item);
+	}
+
 	ssam_cplt_submit(cplt, &evq->work);
 	return 0;
 }
@@ -776,21 +1050,47 @@ static void ssam_cplt_flush(struct ssam_cplt *cplt)
 static void ssam_event_queue_work_fn(struct work_struct *work)
 {
 	struct ssam_event_queue *queue;
+	struct ssam_event_slot *slot;
 	struct ssam_event_item *item;
+	struct ssam_event *event;
+	struct ssam_controller *ctrl;
 	struct ssam_nf *nf;
 	struct device *dev;
 	unsigned int iterations = SSAM_CPLT_WQ_BATCH;
 
 	queue = container_of(work, struct ssam_event_queue, work);
+	ctrl = to_ssam_controller(queue->cplt, cplt);
 	nf = &queue->cplt->event.notif;
 	dev = queue->cplt->dev;
 
-	/* Limit number of processed events to avoid livelocking. */
+	/*
+	 * Limit number of processed events to avoid livelocking. Events in
+	 * the ring are always older than events on the overflow list, so
+	 * drain the ring first.
+	 */
 	do {
+		slot = ssam_event_ring_peek(queue);
+		if (slot) {
+			event = (struct ssam_event *)slot->buf;
+
+			ssh_latency_record(&ctrl->rtl.latency,
+					   SSH_LATENCY_EVENT_DISPATCH,
+					   event->target_category,
+					   slot->timestamp, ktime_get_boottime());
+
+			ssam_nf_call(nf, dev, slot->rqid, event);
+			ssam_event_ring_pop(queue);
+			continue;
+		}
+
 		item = ssam_event_queue_pop(queue);
 		if (!item)
 			return;
 
+		ssh_latency_record(&ctrl->rtl.latency, SSH_LATENCY_EVENT_DISPATCH,
+				   item->event.target_category, item->timestamp,
+				   ktime_get_boottime());
+
 		ssam_nf_call(nf, dev, item->rqid, &item->event);
 		ssam_event_item_free(item);
 	} while (--iterations);
@@ -803,14 +1103,55 @@ static void ssam_event_queue_work_fn(struct work_struct *work)
  * ssam_event_queue_init() - Initialize an event queue.
  * @cplt: The completion system on which the queue resides.
  * @evq:  The event queue to initialize.
+ *
+ * Allocates the event ring of the queue up front, so that events can be
+ * queued on the receive path without allocating memory.
+ *
+ * Return: Returns zero on success or %-ENOMEM if the event ring could not be
+ * allocated.
  */
-static void ssam_event_queue_init(struct ssam_cplt *cplt,
-				  struct ssam_event_queue *evq)
+static int ssam_event_queue_init(struct ssam_cplt *cplt,
+				 struct ssam_event_queue *evq)
 {
+	evq->ring.slots = kcalloc(SSAM_EVENT_RING_SIZE, sizeof(*evq->ring.slots),
+				  GFP_KERNEL);
+	if (!evq->ring.slots)
+		return -ENOMEM;
+
 	evq->cplt = cplt;
+	evq->ring.head = 0;
+	evq->ring.tail = 0;
 	spin_lock_init(&evq->lock);
 	INIT_LIST_HEAD(&evq->head);
+	atomic_set(&evq->count, 0);
 	INIT_WORK(&evq->work, ssam_event_queue_work_fn);
+
+	return 0;
+}
+
+/**
+ * ssam_event_queue_destroy() - Deinitialize an event queue.
+ * @evq: The event queue to deinitialize.
+ *
+ * Frees the event ring of the queue. The queue work item must not be active.
+ */
+static void ssam_event_queue_destroy(struct ssam_event_queue *evq)
+{
+	kfree(evq->ring.slots);
+	evq->ring.slots = NULL;
+}
+
+static void ssam_cplt_destroy_queues(struct ssam_cplt *cplt)
+{
+	struct ssam_event_target *target;
+	int c, i;
+
+	for (c = 0; c < ARRAY_SIZE(cplt->event.target); c++) {
+		target = &cplt->event.target[c];
+
+		for (i = 0; i < ARRAY_SIZE(target->queue); i++)
+			ssam_event_queue_destroy(&target->queue[i]);
+	}
 }
 
 /**
@@ -824,6 +1165,8 @@ static int ssam_cplt_init(struct ssam_cplt *cplt, struct device *dev)
 	int status, c, i;
 
 	cplt->dev = dev;
+	atomic_long_set(&cplt->event.overflow, 0);
+	atomic_long_set(&cplt->event.dropped, 0);
 
 	cplt->wq = alloc_workqueue(SSAM_CPLT_WQ_NAME, WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
 	if (!cplt->wq)
@@ -832,14 +1175,23 @@ static int ssam_cplt_init(struct ssam_cplt *cplt, struct device *dev)
 	for (c = 0; c < ARRAY_SIZE(cplt->event.target); c++) {
 		target = &cplt->event.target[c];
 
-		for (i = 0; i < ARRAY_SIZE(target->queue); i++)
-			ssam_event_queue_init(cplt, &target->queue[i]);
+		for (i = 0; i < ARRAY_SIZE(target->queue); i++) {
+			status = ssam_event_queue_init(cplt, &target->queue[i]);
+			if (status)
+				goto err_queues;
+		}
 	}
 
 	status = ssam_nf_init(&cplt->event.notif);
 	if (status)
-		destroy_workqueue(cplt->wq);
+		goto err_queues;
 
+	return 0;
+
+err_queues:
+	/* The controller is zero-initialized, other queues have no ring yet. */
+	ssam_cplt_destroy_queues(cplt);
+	destroy_workqueue(cplt->wq);
 	return status;
 }
 
@@ -860,8 +1212,160 @@ static void ssam_cplt_destroy(struct ssam_cplt *cplt)
 	 */
 	destroy_workqueue(cplt->wq);
 	ssam_nf_destroy(&cplt->event.notif);
+	ssam_cplt_destroy_queues(cplt);
+}
+
+
+/* -- Synchronous request allocation. -------------------------------------- */
+
+/*
+ * SSAM_REQUEST_CACHE_CLASSES - Number of synchronous request cache classes.
+ */
+#define SSAM_REQUEST_CACHE_CLASSES	3
+
+/*
+ * SSAM_REQUEST_POOL_SIZE - Default number of reserved synchronous requests.
+ *
+ * Default number of synchronous requests reserved per controller for
+ * allocation under memory pressure. Can be overridden via the
+ * request_pool_size module parameter.
+ */
+#define SSAM_REQUEST_POOL_SIZE		4
+
+/*
+ * Maximum payload lengths of the synchronous request cache classes. Requests
+ * with larger payloads will be allocated separately. Chosen to accommodate
+ * common requests without payload, with small arguments, and with ACPI
+ * buffers forwarded by the SAN bridge, respectively.
+ */
+static const size_t ssam_request_cache_payload_len[SSAM_REQUEST_CACHE_CLASSES] = {
+	16, 64, 256,
+};
+
+static const char * const ssam_request_cache_names[SSAM_REQUEST_CACHE_CLASSES] = {
+	"ssam_request_16", "ssam_request_64", "ssam_request_256",
+};
+
+static struct kmem_cache *ssam_request_caches[SSAM_REQUEST_CACHE_CLASSES];
+
+static unsigned int request_pool_size = SSAM_REQUEST_POOL_SIZE;
+module_param(request_pool_size, uint, 0444);
+MODULE_PARM_DESC(request_pool_size, "number of requests reserved per controller for allocation under memory pressure, 0 to disable [default: 4]");
+
+/**
+ * ssam_request_sync_cache_init() - Initialize the synchronous request caches.
+ */
+int ssam_request_sync_cache_init(void)
+{
+	const unsigned int align = __alignof__(struct ssam_request_sync);
+	struct kmem_cache *cache;
+	unsigned int size;
+	int i;
+
+	for (i = 0; i < SSAM_REQUEST_CACHE_CLASSES; i++) {
+		size = sizeof(struct ssam_request_sync)
+		       + SSH_COMMAND_MESSAGE_LENGTH(ssam_request_cache_payload_len[i]);
+
+		cache = kmem_cache_create(ssam_request_cache_names[i], size,
+					  align, 0, NULL);
+		if (!cache) {
+			ssam_request_sync_cache_destroy();
+			return -ENOMEM;
+		}
+
+		ssam_request_caches[i] = cache;
+	}
+
+	return 0;
+}
+
+/**
+ * ssam_request_sync_cache_destroy() - Deinitialize the synchronous request
+ * caches.
+ */
+void ssam_request_sync_cache_destroy(void)
+{
+	int i;
+
+	for (i = 0; i < SSAM_REQUEST_CACHE_CLASSES; i++) {
+		kmem_cache_destroy(ssam_request_caches[i]);
+		ssam_request_caches[i] = NULL;
+	}
 }
 
+/**
+ * ssam_request_sync_pool_create() - Create a memory pool of synchronous
+ * requests.
+ * @size: The number of requests to reserve.
+ *
+ * Creates a memory pool reserving the given number of requests of the
+ * largest cache class.
+ *
+ * Return: Returns the memory pool or %NULL if it could not be created.
+ */
+static mempool_t *ssam_request_sync_pool_create(unsigned int size)
+{
+	struct kmem_cache *cache;
+
+	cache = ssam_request_caches[SSAM_REQUEST_CACHE_CLASSES - 1];
+	return mempool_create_slab_pool(size, cache);
+}
+
+/**
+ * __ssam_request_sync_alloc() - Allocate a synchronous request.
+ * @pool:        The memory pool to fall back to, may be %NULL.
+ * @payload_len: The length of the request payload.
+ * @flags:       Flags used for allocation.
+ *
+ * Allocates a zeroed synchronous request with message buffer from the
+ * smallest cache class that fits the given payload length. If allocation
+ * from the cache fails and a memory pool is provided, the request is taken
+ * from the pool instead. Requests with payloads too large for any cache
+ * class are allocated via kzalloc().
+ *
+ * Return: Returns the allocated request, or %NULL on failure.
+ */
+static struct ssam_request_sync *
+__ssam_request_sync_alloc(mempool_t *pool, size_t payload_len, gfp_t flags)
+{
+	size_t size = sizeof(struct ssam_request_sync)
+		      + SSH_COMMAND_MESSAGE_LENGTH(payload_len);
+	struct ssam_request_sync *rqst;
+	struct kmem_cache *cache;
+	int i;
+
+	for (i = 0; i < SSAM_REQUEST_CACHE_CLASSES; i++) {
+		if (payload_len <= ssam_request_cache_payload_len[i])
+			break;
+	}
+
+	if (i == SSAM_REQUEST_CACHE_CLASSES)
+		return kzalloc(size, flags);
+
+	cache = ssam_request_caches[i];
+
+	if (!pool)
+		rqst = kmem_cache_zalloc(cache, flags);
+	else
+		rqst = kmem_cache_zalloc(cache, (flags & ~__GFP_DIRECT_RECLAIM) |
+					 __GFP_NOWARN);
+
+	if (rqst) {
+		rqst->cache = cache;
+		return rqst;
+	}
+
+	if (!pool)
+		return NULL;
+
+	rqst = mempool_alloc(pool, flags);
+	if (!rqst)
+		return NULL;
+
+	memset(rqst, 0, size);
+	rqst->pool = pool;
+	return rqst;
+}
 
 /* -- Main SSAM device structures. ------------------------------------------ */
 
@@ -986,21 +1490,10 @@ static void ssam_handle_event(struct ssh_rtl *rtl,
 			      const struct ssam_span *data)
 {
 	struct ssam_controller *ctrl = to_ssam_controller(rtl, rtl);
-	struct ssam_event_item *item;
-
-	item = ssam_event_item_alloc(data->len, GFP_KERNEL);
-	if (!item)
-		return;
-
-	item->rqid = get_unaligned_le16(&cmd->rqid);
-	item->event.target_category = cmd->tc;
-	item->event.target_id = cmd->sid;
-	item->event.command_id = cmd->cid;
-	item->event.instance_id = cmd->iid;
-	memcpy(&item->event.data[0], data->ptr, data->len);
+	int status;
 
-	if (WARN_ON(ssam_cplt_submit_event(&ctrl->cplt, item)))
-		ssam_event_item_free(item);
+	status = ssam_cplt_submit_event(&ctrl->cplt, cmd, data);
+	WARN_ON(status == -EINVAL);
 }
 
 static const struct ssh_rtl_ops ssam_rtl_ops = {
@@ -1191,17 +1684,23 @@ int ssam_controller_init(struct ssam_controller *ctrl,
 	ssh_seq_reset(&ctrl->counter.seq);
 	ssh_rqid_reset(&ctrl->counter.rqid);
 
+	/* Reserve requests for allocation under memory pressure. */
+	ctrl->request_pool = NULL;
+	if (request_pool_size) {
+		ctrl->request_pool = ssam_request_sync_pool_create(request_pool_size);
+		if (!ctrl->request_pool)
+			return -ENOMEM;
+	}
+
 	/* Initialize event/request completion system. */
 	status = ssam_cplt_init(&ctrl->cplt, &serdev->dev);
 	if (status)
-		return status;
+		goto err_cplt;
 
 	/* Initialize request and packet transport layers. */
 	status = ssh_rtl_init(&ctrl->rtl, serdev, &ssam_rtl_ops);
-	if (status) {
-		ssam_cplt_destroy(&ctrl->cplt);
-		return status;
-	}
+	if (status)
+		goto err_rtl;
 
 	/*
 	 * Set state via write_once even though we expect to be in an
@@ -1210,6 +1709,13 @@ int ssam_controller_init(struct ssam_controller *ctrl,
 	 */
 	WRITE_ONCE(ctrl->state, SSAM_CONTROLLER_INITIALIZED);
 	return 0;
+
+err_rtl:
+	ssam_cplt_destroy(&ctrl->cplt);
+err_cplt:
+	mempool_destroy(ctrl->request_pool);
+	ctrl->request_pool = NULL;
+	return status;
 }
 
 /**
@@ -1367,6 +1873,8 @@ void ssam_controller_destroy(struct ssam_controller *ctrl)
 	/* Actually free resources. */
 	ssam_cplt_destroy(&ctrl->cplt);
 	ssh_rtl_destroy(&ctrl->rtl);
+	mempool_destroy(ctrl->request_pool);
+	ctrl->request_pool = NULL;
 
 	/*
 	 * Set state via write_once even though we expect to be locked/in an
@@ -1376,6 +1884,51 @@ void ssam_controller_destroy(struct ssam_controller *ctrl)
 	WRITE_ONCE(ctrl->state, SSAM_CONTROLLER_UNINITIALIZED);
 }
 
+static int ssam_debugfs_counter_get(void *data, u64 *val)
+{
+	*val = atomic_long_read(data);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(ssam_debugfs_counter_fops, ssam_debugfs_counter_get,
+			 NULL, "%llu\n");
+
+/**
+ * ssam_controller_debugfs_init() - Create debugfs entries for the controller.
+ * @ctrl:   The controller.
+ * @parent: The debugfs directory to create the controller directory in.
+ *
+ * Creates a directory for the controller, named after its serial device, and
+ * populates it with debugging information of the transport layers. The
+ * entries must be removed via ssam_controller_debugfs_remove() before the
+ * controller is destroyed.
+ */
+void ssam_controller_debugfs_init(struct ssam_controller *ctrl,
+				  struct dentry *parent)
+{
+	struct device *dev = ssam_controller_device(ctrl);
+
+	ctrl->debugfs = debugfs_create_dir(dev_name(dev), parent);
+	ssh_ptl_debugfs_init(&ctrl->rtl.ptl, ctrl->debugfs);
+	ssh_latency_debugfs_init(&ctrl->rtl.latency, ctrl->debugfs);
+
+	debugfs_create_file_unsafe("event_overflow", 0444, ctrl->debugfs,
+				   &ctrl->cplt.event.overflow,
+				   &ssam_debugfs_counter_fops);
+	debugfs_create_file_unsafe("event_dropped", 0444, ctrl->debugfs,
+				   &ctrl->cplt.event.dropped,
+				   &ssam_debugfs_counter_fops);
+}
+
+/**
+ * ssam_controller_debugfs_remove() - Remove debugfs entries of the controller.
+ * @ctrl: The controller.
+ */
+void ssam_controller_debugfs_remove(struct ssam_controller *ctrl)
+{
+	debugfs_remove_recursive(ctrl->debugfs);
+	ctrl->debugfs = NULL;
+}
+
 /**
  * ssam_controller_suspend() - Suspend the controller.
  * @ctrl: The controller to suspend.
@@ -1561,14 +2114,12 @@ int ssam_request_sync_alloc(size_t payload_len, gfp_t flags,
 			    struct ssam_request_sync **rqst,
 			    struct ssam_span *buffer)
 {
-	size_t msglen = SSH_COMMAND_MESSAGE_LENGTH(payload_len);
-
-	*rqst = kzalloc(sizeof(**rqst) + msglen, flags);
+	*rqst = __ssam_request_sync_alloc(NULL, payload_len, flags);
 	if (!*rqst)
 		return -ENOMEM;
 
 	buffer->ptr = (u8 *)(*rqst + 1);
-	buffer->len = msglen;
+	buffer->len = SSH_COMMAND_MESSAGE_LENGTH(payload_len);
 
 	return 0;
 }
@@ -1591,7 +2142,12 @@ EXPORT_SYMBOL_GPL(ssam_request_sync_alloc);
  */
 void ssam_request_sync_free(struct ssam_request_sync *rqst)
 {
-	kfree(rqst);
+	if (rqst->pool)
+		mempool_free(rqst, rqst->pool);
+	else if (rqst->cache)
+		kmem_cache_free(rqst->cache, rqst);
+	else
+		kfree(rqst);
 }
 EXPORT_SYMBOL_GPL(ssam_request_sync_free);
 
@@ -1624,26 +2180,9 @@ int ssam_request_sync_init(struct ssam_request_sync *rqst,
 }
 EXPORT_SYMBOL_GPL(ssam_request_sync_init);
 
-/**
- * ssam_request_sync_submit() - Submit a synchronous request.
- * @ctrl: The controller with which to submit the request.
- * @rqst: The request to submit.
- *
- * Submit a synchronous request. The request has to be initialized and
- * properly set up, including response buffer (may be %NULL if no response is
- * expected) and command message data. This function does not wait for the
- * request to be completed.
- *
- * If this function succeeds, ssam_request_sync_wait() must be used to ensure
- * that the request has been completed before the response data can be
- * accessed and/or the request can be freed. On failure, the request may
- * immediately be freed.
- *
- * This function may only be used if the controller is active, i.e. has been
- * initialized and not suspended.
- */
-int ssam_request_sync_submit(struct ssam_controller *ctrl,
-			     struct ssam_request_sync *rqst)
+static int __ssam_request_sync_submit(struct ssam_controller *ctrl,
+				      struct ssam_request_sync *rqst,
+				      bool direct)
 {
 	int status;
 
@@ -1666,38 +2205,83 @@ int ssam_request_sync_submit(struct ssam_controller *ctrl,
 		return -ENODEV;
 	}
 
-	status = ssh_rtl_submit(&ctrl->rtl, &rqst->base);
+	if (direct)
+		status = ssh_rtl_submit_direct(&ctrl->rtl, &rqst->base);
+	else
+		status = ssh_rtl_submit(&ctrl->rtl, &rqst->base);
+
 	ssh_request_put(&rqst->base);
 
 	return status;
 }
+
+/**
+ * ssam_request_sync_submit() - Submit a synchronous request.
+ * @ctrl: The controller with which to submit the request.
+ * @rqst: The request to submit.
+ *
+ * Submit a synchronous request. The request has to be initialized and
+ * properly set up, including response buffer (may be %NULL if no response is
+ * expected) and command message data. This function does not wait for the
+ * request to be completed.
+ *
+ * If this function succeeds, ssam_request_sync_wait() must be used to ensure
+ * that the request has been completed before the response data can be
+ * accessed and/or the request can be freed. On failure, the request may
+ * immediately be freed.
+ *
+ * This function may only be used if the controller is active, i.e. has been
+ * initialized and not suspended. It may be called from any context. The
+ * request is passed on to the transport layer by a work item.
+ */
+int ssam_request_sync_submit(struct ssam_controller *ctrl,
+			     struct ssam_request_sync *rqst)
+{
+	return __ssam_request_sync_submit(ctrl, rqst, false);
+}
 EXPORT_SYMBOL_GPL(ssam_request_sync_submit);
 
 /**
  * ssam_request_do_sync() - Execute a synchronous request.
- * @ctrl: The controller via which the request will be submitted.
- * @spec: The request specification and payload.
- * @rsp:  The response buffer.
- *
- * Allocates a synchronous request with its message data buffer on the heap
- * via ssam_request_sync_alloc(), fully initializes it via the provided
- * request specification, submits it, and finally waits for its completion
- * before freeing it and returning its status.
+ * @ctrl:  The controller via which the request will be submitted.
+ * @spec:  The request specification and payload.
+ * @rsp:   The response buffer.
+ * @flags: Flags used for allocating the request.
+ *
+ * Allocates a synchronous request with its message data buffer on the heap,
+ * falling back to the request pool of the controller under memory pressure,
+ * fully initializes it via the provided request specification, submits it,
+ * and finally waits for its completion before freeing it and returning its
+ * status. Must be called from a context that is allowed to sleep. Callers on
+ * reclaim or I/O paths should pass %GFP_NOIO as @flags.
+ *
+ * Note: The request pool only covers payloads of up to 256 bytes. Requests
+ * with larger payloads are allocated via kzalloc() without any fallback and
+ * may thus fail with %-ENOMEM under memory pressure.
  *
  * Return: Returns the status of the request or any failure during setup.
  */
 int ssam_request_do_sync(struct ssam_controller *ctrl,
 			 const struct ssam_request *spec,
-			 struct ssam_response *rsp)
+			 struct ssam_response *rsp, gfp_t flags)
 {
 	struct ssam_request_sync *rqst;
 	struct ssam_span buf;
 	ssize_t len;
 	int status;
 
-	status = ssam_request_sync_alloc(spec->length, GFP_KERNEL, &rqst, &buf);
-	if (status)
-		return status;
+	/*
+	 * Fall back to the request pool of the controller so that requests
+	 * can still be executed under memory pressure, e.g. from reclaim or
+	 * suspend paths.
+	 */
+	rqst = __ssam_request_sync_alloc(ctrl->request_pool, spec->length,
+					 flags);
+	if (!rqst)
+		return -ENOMEM;
+
+	buf.ptr = (u8 *)(rqst + 1);
+	buf.len = SSH_COMMAND_MESSAGE_LENGTH(spec->length);
 
 	status = ssam_request_sync_init(rqst, spec->flags);
 	if (status) {
@@ -1715,7 +2299,7 @@ int ssam_request_do_sync(struct ssam_controller *ctrl,
 
 	ssam_request_sync_set_data(rqst, buf.ptr, len);
 
-	status = ssam_request_sync_submit(ctrl, rqst);
+	status = __ssam_request_sync_submit(ctrl, rqst, true);
 	if (!status)
 		status = ssam_request_sync_wait(rqst);
 
@@ -1741,7 +2325,7 @@ EXPORT_SYMBOL_GPL(ssam_request_do_sync);
  * This function does essentially the same as ssam_request_do_sync(), but
  * instead of dynamically allocating the request and message data buffer, it
  * uses the provided message data buffer and stores the (small) request struct
- * on the heap.
+ * on the heap. Must be called from a context that is allowed to sleep.
  *
  * Return: Returns the status of the request or any failure during setup.
  */
@@ -1766,7 +2350,7 @@ int ssam_request_do_sync_with_buffer(struct ssam_controller *ctrl,
 
 	ssam_request_sync_set_data(&rqst, buf->ptr, len);
 
-	status = ssam_request_sync_submit(ctrl, &rqst);
+	status = __ssam_request_sync_submit(ctrl, &rqst, true);
 	if (!status)
 		status = ssam_request_sync_wait(&rqst);
 
@@ -1774,6 +2358,290 @@ int ssam_request_do_sync_with_buffer(struct ssam_controller *ctrl,
 }
 EXPORT_SYMBOL_GPL(ssam_request_do_sync_with_buffer);
 
+/**
+ * ssam_request_batch() - Execute multiple independent requests as batch.
+ * @ctrl:   The controller via which the requests will be submitted.
+ * @specs:  The request specifications and payloads.
+ * @rsps:   The response buffers, one for each request. May be %NULL if none
+ *          of the requests has a response.
+ * @status: Array receiving the status of each request.
+ * @count:  The number of requests.
+ *
+ * Allocates and fully initializes a synchronous request for each of the
+ * provided request specifications, submits all of them at once, and finally
+ * waits for all of them to be completed before freeing them. Submitting the
+ * requests as a single unit allows the transport layer to pipeline them,
+ * i.e. to have multiple requests in flight at the same time. The requests
+ * must therefore not depend on each other. They are, however, submitted in
+ * the order given.
+ *
+ * The status of each request, i.e. its submission status or, if it has been
+ * submitted successfully, its completion status, is stored in the respective
+ * entry of @status. If setting up any of the requests fails, none of them
+ * will be submitted and the @status array will not be modified.
+ *
+ * Note that, in contrast to ssam_request_do_sync(), the requests are not
+ * backed by the reserved request pool of the controller, i.e. allocation may
+ * fail under memory pressure.
+ *
+ * Return: Returns zero if all requests have been completed successfully, the
+ * status of the first failed request if any request has failed, %-ENOMEM if
+ * the requests could not be allocated, or the error code of any other failure
+ * during setup.
+ */
+int ssam_request_batch(struct ssam_controller *ctrl,
+		       const struct ssam_request *specs,
+		       struct ssam_response *rsps, int *status,
+		       unsigned int count)
+{
+	struct ssam_request_sync **rqsts;
+	struct ssh_request **base;
+	struct ssam_span buf;
+	unsigned int i, n;
+	ssize_t len;
+	int ret = 0;
+
+	if (!count)
+		return 0;
+
+	rqsts = kcalloc(count, sizeof(*rqsts) + sizeof(*base), GFP_KERNEL);
+	if (!rqsts)
+		return -ENOMEM;
+
+	base = (struct ssh_request **)(rqsts + count);
+
+	/*
+	 * Set up requests. Do not fall back to the request pool here: Taking
+	 * more than one element from a memory pool can deadlock, as the pool
+	 * may wait for elements held by this very call to be returned.
+	 */
+	for (n = 0; n < count; n++) {
+		rqsts[n] = __ssam_request_sync_alloc(NULL, specs[n].length,
+						     GFP_KERNEL);
+		if (!rqsts[n]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		buf.ptr = (u8 *)(rqsts[n] + 1);
+		buf.len = SSH_COMMAND_MESSAGE_LENGTH(specs[n].length);
+
+		ret = ssam_request_sync_init(rqsts[n], specs[n].flags);
+		if (ret) {
+			ssam_request_sync_free(rqsts[n]);
+			goto out;
+		}
+
+		ssam_request_sync_set_resp(rqsts[n], rsps ? &rsps[n] : NULL);
+
+		len = ssam_request_write_data(&buf, ctrl, &specs[n]);
+		if (len < 0) {
+			ssam_request_sync_free(rqsts[n]);
+			ret = len;
+			goto out;
+		}
+
+		ssam_request_sync_set_data(rqsts[n], buf.ptr, len);
+		base[n] = &rqsts[n]->base;
+	}
+
+	/* See ssam_request_sync_submit(). */
+	if (WARN_ON(READ_ONCE(ctrl->state) != SSAM_CONTROLLER_STARTED)) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	ssh_rtl_submit_batch(&ctrl->rtl, base, status, count);
+
+	/*
+	 * Drop our references. Requests that could not be submitted are
+	 * released immediately, the others once they have been completed.
+	 */
+	for (i = 0; i < count; i++)
+		ssh_request_put(base[i]);
+
+	/* Wait for completion of all submitted requests. */
+	for (i = 0; i < count; i++) {
+		if (!status[i])
+			status[i] = ssam_request_sync_wait(rqsts[i]);
+
+		if (status[i] && !ret)
+			ret = status[i];
+
+		ssam_request_sync_free(rqsts[i]);
+	}
+
+	kfree(rqsts);
+	return ret;
+
+out:
+	/* Free the requests that have been set up completely. */
+	for (i = 0; i < n; i++)
+		ssam_request_sync_free(rqsts[i]);
+
+	kfree(rqsts);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(ssam_request_batch);
+
+static void ssam_request_async_complete(struct ssh_request *rqst,
+					const struct ssh_command *cmd,
+					const struct ssam_span *data, int status)
+{
+	struct ssh_rtl *rtl = ssh_request_rtl(rqst);
+	struct ssam_request_async *r;
+
+	r = container_of(rqst, struct ssam_request_async, base);
+
+	if (status)
+		rtl_dbg_cond(rtl, "rsp: request failed: %d\n", status);
+
+	r->complete(r, status ? NULL : data, status, r->context);
+}
+
+static void ssam_request_async_release(struct ssh_request *rqst)
+{
+	kfree(container_of(rqst, struct ssam_request_async, base));
+}
+
+static const struct ssh_request_ops ssam_request_async_ops = {
+	.release = ssam_request_async_release,
+	.complete = ssam_request_async_complete,
+};
+
+/**
+ * ssam_request_async_submit() - Submit an asynchronous request.
+ * @ctrl:     The controller via which the request will be submitted.
+ * @spec:     The request specification and payload.
+ * @complete: The callback to invoke on completion of the request.
+ * @context:  The context passed to the completion callback.
+ * @flags:    Flags used for allocation.
+ *
+ * Allocates an asynchronous request with its message data buffer on the heap,
+ * fully initializes it via the provided request specification, and submits
+ * it without waiting for its completion. The request payload is copied and
+ * does not need to outlive this call.
+ *
+ * Once the request has been completed, successfully or not, the @complete
+ * callback is invoked exactly once with the response payload and status of
+ * the request. The callback is usually executed in the context of the
+ * transport layer, e.g. its receiver thread, and should therefore not block.
+ * If @flags allow blocking, it may also be executed in the context of the
+ * caller before this function returns, e.g. if the transport layer fails the
+ * request while it is being submitted. The caller must thus not hold any locks
+ * taken by the callback. The response payload is only valid for the duration
+ * of the callback and must be copied if it is needed afterwards.
+ *
+ * The returned request serves as handle, e.g. for canceling the request via
+ * ssam_request_async_cancel(). The reference held by the caller must be
+ * dropped via ssam_request_async_put(), which can be done immediately if the
+ * handle is not needed. The request is freed once it has been completed and
+ * all references to it have been dropped.
+ *
+ * This function may only be used if the controller is active, i.e. has been
+ * initialized and not suspended. It may be called from any context, provided
+ * that the given allocation @flags are suitable for that context. If @flags
+ * allow blocking, the request is passed on to the transport layer directly,
+ * otherwise by a work item.
+ *
+ * Return: Returns the submitted request on success. Returns %-ENOMEM if the
+ * request could not be allocated, %-EINVAL if the request specification is
+ * invalid, %-ENODEV if the controller is not active, or %-ESHUTDOWN if the
+ * controller is being shut down. The completion callback will not be invoked
+ * if submission has failed.
+ */
+struct ssam_request_async *
+ssam_request_async_submit(struct ssam_controller *ctrl,
+			  const struct ssam_request *spec,
+			  ssam_request_async_fn_t complete, void *context,
+			  gfp_t flags)
+{
+	struct ssam_request_async *rqst;
+	struct ssam_span buf;
+	ssize_t len;
+	int status;
+
+	if (spec->length > SSH_COMMAND_MAX_PAYLOAD_SIZE)
+		return ERR_PTR(-EINVAL);
+
+	buf.len = SSH_COMMAND_MESSAGE_LENGTH(spec->length);
+
+	rqst = kzalloc(sizeof(*rqst) + buf.len, flags);
+	if (!rqst)
+		return ERR_PTR(-ENOMEM);
+
+	buf.ptr = (u8 *)(rqst + 1);
+
+	status = ssh_request_init(&rqst->base, spec->flags,
+				  &ssam_request_async_ops);
+	if (status) {
+		kfree(rqst);
+		return ERR_PTR(status);
+	}
+
+	rqst->complete = complete;
+	rqst->context = context;
+
+	len = ssam_request_write_data(&buf, ctrl, spec);
+	if (len < 0) {
+		ssh_request_put(&rqst->base);
+		return ERR_PTR(len);
+	}
+
+	ssh_request_set_data(&rqst->base, buf.ptr, len);
+
+	/* See ssam_request_sync_submit(). */
+	if (WARN_ON(READ_ONCE(ctrl->state) != SSAM_CONTROLLER_STARTED)) {
+		ssh_request_put(&rqst->base);
+		return ERR_PTR(-ENODEV);
+	}
+
+	/*
+	 * Get the reference returned to the caller. The initial reference is
+	 * dropped after submission, as for synchronous requests.
+	 */
+	ssh_request_get(&rqst->base);
+
+	if (gfpflags_allow_blocking(flags))
+		status = ssh_rtl_submit_direct(&ctrl->rtl, &rqst->base);
+	else
+		status = ssh_rtl_submit(&ctrl->rtl, &rqst->base);
+
+	ssh_request_put(&rqst->base);
+
+	if (status) {
+		ssh_request_put(&rqst->base);
+		return ERR_PTR(status);
+	}
+
+	return rqst;
+}
+EXPORT_SYMBOL_GPL(ssam_request_async_submit);
+
+/**
+ * ssam_request_async_cancel() - Cancel an asynchronous request.
+ * @rqst: The request to cancel.
+ *
+ * Cancels the given request, regardless of whether it is still queued or has
+ * already been passed on to the underlying transport. If the request has not
+ * been completed before, its completion callback will be invoked with
+ * %-ECANCELED as status. This may happen during execution of this function,
+ * but also some time after it, e.g. if the request is currently being
+ * transmitted. The caller still needs to drop its reference to the request
+ * via ssam_request_async_put().
+ *
+ * Return: Returns %true if the request has been canceled, either by this call
+ * or before, or %false if it had already been completed.
+ */
+bool ssam_request_async_cancel(struct ssam_request_async *rqst)
+{
+	if (test_bit(SSH_REQUEST_SF_COMPLETED_BIT, &rqst->base.state))
+		return false;
+
+	return ssh_rtl_cancel(&rqst->base, true);
+}
+EXPORT_SYMBOL_GPL(ssam_request_async_cancel);
+
 
 /* -- Internal SAM requests. ------------------------------------------------ */
 
@@ -2309,7 +3177,7 @@ int ssam_notifier_register(struct ssam_controller *ctrl, struct ssam_event_notif
 		}
 	}
 
-	status = ssam_nfblk_insert(nf_head, &n->base);
+	status = ssam_nfblk_insert(nf_head, n);
 	if (status) {
 		if (entry)
 			ssam_nf_refcount_dec_free(nf, n->event.reg, n->event.id);
@@ -2370,7 +3238,7 @@ int __ssam_notifier_unregister(struct ssam_controller *ctrl, struct ssam_event_n
 
 	mutex_lock(&nf->lock);
 
-	if (!ssam_nfblk_find(nf_head, &n->base)) {
+	if (!ssam_nfblk_find(nf_head, n)) {
 		mutex_unlock(&nf->lock);
 		return -ENOENT;
 	}
@@ -9,7 +9,9 @@
 #define _SURFACE_AGGREGATOR_CONTROLLER_H
 
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/mempool.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
 #include <linux/rwsem.h>
@@ -46,14 +48,26 @@ struct ssh_rqid_counter {
 
 /* -- Event/notification system. -------------------------------------------- */
 
+/*
+ * SSAM_NF_INDEX_BITS - Size of the notifier dispatch index.
+ *
+ * Number of bits of the notifier key used to index the table of notifier
+ * chains of each notifier head.
+ */
+#define SSAM_NF_INDEX_BITS	4
+
 /**
  * struct ssam_nf_head - Notifier head for SSAM events.
- * @srcu: The SRCU struct for synchronization.
- * @head: List-head for notifier blocks registered under this head.
+ * @srcu:  The SRCU struct for synchronization.
+ * @seq:   Sequence number assigned to the next registered notifier block.
+ * @index: Chains of notifier blocks registered under this head, hashed by
+ *         the target and instance ID they filter on. Each chain is sorted by
+ *         priority and registration order.
  */
 struct ssam_nf_head {
 	struct srcu_struct srcu;
-	struct list_head head;
+	unsigned long seq;
+	struct hlist_head index[1 << SSAM_NF_INDEX_BITS];
 };
 
 /**
@@ -80,6 +94,7 @@ struct ssam_cplt;
  * struct ssam_event_item - Struct for event queuing and completion.
  * @node:     The node in the queue.
  * @rqid:     The request ID of the event.
+ * @timestamp: Time at which the event has been received.
  * @ops:      Instance specific functions.
  * @ops.free: Callback for freeing this event item.
  * @event:    Actual event data.
@@ -87,6 +102,7 @@ struct ssam_cplt;
 struct ssam_event_item {
 	struct list_head node;
 	u16 rqid;
+	ktime_t timestamp;
 
 	struct {
 		void (*free)(struct ssam_event_item *event);
@@ -95,18 +111,69 @@ struct ssam_event_item {
 	struct ssam_event event;	/* must be last */
 };
 
+/*
+ * SSAM_EVENT_RING_SIZE - Number of slots in the event ring of a queue.
+ *
+ * Must be a power of two. Events received while the ring is full are queued
+ * on the overflow list of the event queue.
+ */
+#define SSAM_EVENT_RING_SIZE		16
+
+/*
+ * SSAM_EVENT_RING_PAYLOAD_LEN - Maximum payload length for event ring slots.
+ *
+ * Chosen to accommodate standard touchpad and keyboard input events. Events
+ * with larger payloads are queued on the overflow list of the event queue.
+ */
+#define SSAM_EVENT_RING_PAYLOAD_LEN	32
+
+/**
+ * struct ssam_event_slot - Slot of an event ring.
+ * @rqid:      The request ID of the event.
+ * @timestamp: Time at which the event has been received.
+ * @buf:       Storage for the event, i.e. a &struct ssam_event including its
+ *             payload.
+ */
+struct ssam_event_slot {
+	u16 rqid;
+	ktime_t timestamp;
+	u8 buf[sizeof(struct ssam_event) + SSAM_EVENT_RING_PAYLOAD_LEN]
+		__aligned(__alignof__(struct ssam_event));
+};
+
 /**
  * struct ssam_event_queue - Queue for completing received events.
- * @cplt: Reference to the completion system on which this queue is active.
- * @lock: The lock for any operation on the queue.
- * @head: The list-head of the queue.
- * @work: The &struct work_struct performing completion work for this queue.
+ * @cplt:       Reference to the completion system on which this queue is
+ *              active.
+ * @ring:       Ring of preallocated event slots, single producer (receiver)
+ *              and single consumer (queue work item).
+ * @ring.slots: The slots of the ring. Allocated when the queue is
+ *              initialized.
+ * @ring.head:  Index of the next slot to be written. Only modified by the
+ *              producer.
+ * @ring.tail:  Index of the next slot to be read. Only modified by the
+ *              consumer.
+ * @lock:       The lock for any operation on the overflow list.
+ * @head:       The list-head of the overflow list, holding events that could
+ *              not be placed in the ring.
+ * @count:      Number of events on the overflow list. As long as this is
+ *              nonzero, new events are placed on the overflow list to
+ *              preserve their order.
+ * @work:       The &struct work_struct performing completion work for this
+ *              queue.
  */
 struct ssam_event_queue {
 	struct ssam_cplt *cplt;
 
+	struct {
+		struct ssam_event_slot *slots;
+		unsigned int head;
+		unsigned int tail;
+	} ring;
+
 	spinlock_t lock;
 	struct list_head head;
+	atomic_t count;
 	struct work_struct work;
 };
 
@@ -127,6 +194,12 @@ struct ssam_event_target {
  * @event:        Event completion management.
  * @event.target: Array of &struct ssam_event_target, one for each target.
  * @event.notif:  Notifier callbacks and event activation reference counting.
+ * @event.overflow: Number of events that could not be placed in the event
+ *                ring of their queue, e.g. because the ring was full, the
+ *                overflow list was not empty, or the payload was too large.
+ * @event.dropped: Number of events that could not be placed in the event
+ *                ring and have been dropped because no memory could be
+ *                allocated for them.
  */
 struct ssam_cplt {
 	struct device *dev;
@@ -135,6 +208,8 @@ struct ssam_cplt {
 	struct {
 		struct ssam_event_target target[SSH_NUM_TARGETS];
 		struct ssam_nf notif;
+		atomic_long_t overflow;
+		atomic_long_t dropped;
 	} event;
 };
 
@@ -194,6 +269,9 @@ struct ssam_controller_caps {
  * @irq.num:      The wakeup IRQ number.
  * @irq.wakeup_enabled: Whether wakeup by IRQ is enabled during suspend.
  * @caps: The controller device capabilities.
+ * @request_pool: Reserve of synchronous requests, ensuring that requests can
+ *                be allocated under memory pressure. May be %NULL.
+ * @debugfs: The debugfs directory of the controller.
  */
 struct ssam_controller {
 	struct kref kref;
@@ -215,6 +293,10 @@ struct ssam_controller {
 	} irq;
 
 	struct ssam_controller_caps caps;
+
+	mempool_t *request_pool;
+
+	struct dentry *debugfs;
 };
 
 #define to_ssam_controller(ptr, member) \
@@ -259,6 +341,10 @@ int ssam_controller_start(struct ssam_controller *ctrl);
 void ssam_controller_shutdown(struct ssam_controller *ctrl);
 void ssam_controller_destroy(struct ssam_controller *ctrl);
 
+void ssam_controller_debugfs_init(struct ssam_controller *ctrl,
+				  struct dentry *parent);
+void ssam_controller_debugfs_remove(struct ssam_controller *ctrl);
+
 int ssam_notifier_disable_registered(struct ssam_controller *ctrl);
 void ssam_notifier_restore_registered(struct ssam_controller *ctrl);
 
@@ -282,4 +368,7 @@ int ssam_controller_resume(struct ssam_controller *ctrl);
 int ssam_event_item_cache_init(void);
 void ssam_event_item_cache_destroy(void);
 
+int ssam_request_sync_cache_init(void);
+void ssam_request_sync_cache_destroy(void);
+
 #endif /* _SURFACE_AGGREGATOR_CONTROLLER_H */
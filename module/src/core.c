@@ -13,6 +13,7 @@
 #include <linux/acpi.h>
 #include <linux/atomic.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/gpio/consumer.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
@@ -26,6 +27,7 @@
 
 #include "bus.h"
 #include "controller.h"
+#include "ssh_crc.h"
 
 #define CREATE_TRACE_POINTS
 #include "trace.h"
@@ -285,8 +287,44 @@ static ssize_t firmware_version_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(firmware_version);
 
+#define SSAM_STAT_ATTR_RO(name, counter)					\
+	static ssize_t name##_show(struct device *dev,				\
+				   struct device_attribute *attr, char *buf)	\
+	{									\
+		struct ssam_controller *ctrl = dev_get_drvdata(dev);		\
+										\
+		return sysfs_emit(buf, "%ld\n",					\
+				  atomic_long_read(&ctrl->rtl.counter));	\
+	}									\
+	static DEVICE_ATTR_RO(name)
+
+SSAM_STAT_ATTR_RO(rx_bytes, ptl.stats.rx_bytes);
+SSAM_STAT_ATTR_RO(rx_frames, ptl.stats.rx_frames);
+SSAM_STAT_ATTR_RO(tx_bytes, ptl.stats.tx_bytes);
+SSAM_STAT_ATTR_RO(tx_frames, ptl.stats.tx_frames);
+SSAM_STAT_ATTR_RO(crc_errors, ptl.stats.crc_errors);
+SSAM_STAT_ATTR_RO(invalid_syn, ptl.stats.invalid_syn);
+SSAM_STAT_ATTR_RO(rx_naks, ptl.stats.rx_naks);
+SSAM_STAT_ATTR_RO(tx_naks, ptl.stats.tx_naks);
+SSAM_STAT_ATTR_RO(retransmissions, ptl.stats.retransmissions);
+SSAM_STAT_ATTR_RO(packet_timeouts, ptl.stats.timeouts);
+SSAM_STAT_ATTR_RO(request_timeouts, stats.timeouts);
+SSAM_STAT_ATTR_RO(unexpected_responses, stats.unexpected);
+
 static struct attribute *ssam_sam_attrs[] = {
 	&dev_attr_firmware_version.attr,
+	&dev_attr_rx_bytes.attr,
+	&dev_attr_rx_frames.attr,
+	&dev_attr_tx_bytes.attr,
+	&dev_attr_tx_frames.attr,
+	&dev_attr_crc_errors.attr,
+	&dev_attr_invalid_syn.attr,
+	&dev_attr_rx_naks.attr,
+	&dev_attr_tx_naks.attr,
+	&dev_attr_retransmissions.attr,
+	&dev_attr_packet_timeouts.attr,
+	&dev_attr_request_timeouts.attr,
+	&dev_attr_unexpected_responses.attr,
 	NULL
 };
 
@@ -295,6 +333,9 @@ static const struct attribute_group ssam_sam_group = {
 	.attrs = ssam_sam_attrs,
 };
 
+/* Root debugfs directory of this module, containing controller directories. */
+static struct dentry *ssam_debugfs_root;
+
 
 /* -- ACPI based device setup. ---------------------------------------------- */
 
@@ -684,6 +725,8 @@ static int ssam_serial_hub_probe(struct serdev_device *serdev)
 	if (status)
 		goto err_irq;
 
+	ssam_controller_debugfs_init(ctrl, ssam_debugfs_root);
+
 	/* Finally, set main controller reference. */
 	status = ssam_try_set_controller(ctrl);
 	if (WARN_ON(status))	/* Currently, we're the only provider. */
@@ -705,6 +748,7 @@ static int ssam_serial_hub_probe(struct serdev_device *serdev)
 	return 0;
 
 err_mainref:
+	ssam_controller_debugfs_remove(ctrl);
 	ssam_irq_free(ctrl);
 err_irq:
 	sysfs_remove_group(&serdev->dev.kobj, &ssam_sam_group);
@@ -729,6 +773,8 @@ static void ssam_serial_hub_remove(struct serdev_device *serdev)
 	/* Clear static reference so that no one else can get a new one. */
 	ssam_clear_controller();
 
+	ssam_controller_debugfs_remove(ctrl);
+
 	/* Disable and free IRQ. */
 	ssam_irq_free(ctrl);
 
@@ -790,6 +836,8 @@ static int __init ssam_core_init(void)
 {
 	int status;
 
+	ssh_crc_init();
+
 	status = ssam_bus_register();
 	if (status)
 		goto err_bus;
@@ -802,6 +850,12 @@ static int __init ssam_core_init(void)
 	if (status)
 		goto err_evitem;
 
+	status = ssam_request_sync_cache_init();
+	if (status)
+		goto err_rqst;
+
+	ssam_debugfs_root = debugfs_create_dir("surface_aggregator", NULL);
+
 	status = serdev_device_driver_register(&ssam_serial_hub);
 	if (status)
 		goto err_register;
@@ -809,6 +863,9 @@ static int __init ssam_core_init(void)
 	return 0;
 
 err_register:
+	debugfs_remove_recursive(ssam_debugfs_root);
+	ssam_request_sync_cache_destroy();
+err_rqst:
 	ssam_event_item_cache_destroy();
 err_evitem:
 	ssh_ctrl_packet_cache_destroy();
@@ -822,6 +879,8 @@ subsys_initcall(ssam_core_init);
 static void __exit ssam_core_exit(void)
 {
 	serdev_device_driver_unregister(&ssam_serial_hub);
+	debugfs_remove_recursive(ssam_debugfs_root);
+	ssam_request_sync_cache_destroy();
 	ssam_event_item_cache_destroy();
 	ssh_ctrl_packet_cache_destroy();
 	ssam_bus_unregister();
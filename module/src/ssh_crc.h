@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SSH message CRC computation.
+ *
+ * Copyright (C) 2019-2022 Maximilian Luz <luzmaximilian@gmail.com>
+ */
+
+#ifndef _SURFACE_AGGREGATOR_SSH_CRC_H
+#define _SURFACE_AGGREGATOR_SSH_CRC_H
+
+#include <linux/types.h>
+
+void ssh_crc_init(void);
+u16 ssh_crc_update(u16 crc, const u8 *buf, size_t len);
+u16 ssh_crc_compute(const u8 *buf, size_t len);
+
+#endif /* _SURFACE_AGGREGATOR_SSH_CRC_H */
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Latency statistics for SSH requests and events.
+ *
+ * Copyright (C) 2019-2022 Maximilian Luz <luzmaximilian@gmail.com>
+ */
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#include "ssh_latency.h"
+
+static_assert(SSAM_SSH_TC_POS < SSH_LATENCY_NUM_TC);
+
+static const char * const ssh_latency_stage_names[SSH_LATENCY_NUM_STAGES] = {
+	[SSH_LATENCY_SUBMIT_TX]      = "submit_tx",
+	[SSH_LATENCY_TX_ACK]         = "tx_ack",
+	[SSH_LATENCY_TX_RESPONSE]    = "tx_response",
+	[SSH_LATENCY_EVENT_DISPATCH] = "event_dispatch",
+};
+
+/**
+ * ssh_latency_init() - Initialize latency statistics.
+ * @lat: The latency statistics to initialize.
+ *
+ * Allocates the per-CPU counters of all stages. If debugfs is disabled, no
+ * counters are allocated and no latencies will be recorded.
+ *
+ * Return: Returns zero on success or %-ENOMEM if the counters could not be
+ * allocated.
+ */
+int ssh_latency_init(struct ssh_latency *lat)
+{
+	int i;
+
+	if (!IS_ENABLED(CONFIG_DEBUG_FS))
+		return 0;
+
+	for (i = 0; i < SSH_LATENCY_NUM_STAGES; i++) {
+		lat->stage[i].counts = alloc_percpu(struct ssh_latency_counts);
+		if (!lat->stage[i].counts) {
+			ssh_latency_destroy(lat);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * ssh_latency_destroy() - Deinitialize latency statistics.
+ * @lat: The latency statistics to deinitialize.
+ *
+ * Frees the counters of the given latency statistics. Any debugfs entries
+ * created for them must have been removed before.
+ */
+void ssh_latency_destroy(struct ssh_latency *lat)
+{
+	int i;
+
+	for (i = 0; i < SSH_LATENCY_NUM_STAGES; i++) {
+		free_percpu(lat->stage[i].counts);
+		lat->stage[i].counts = NULL;
+	}
+}
+
+/**
+ * ssh_latency_hist_reset() - Reset latency histogram.
+ * @h: The histogram to reset.
+ *
+ * Sets all counters of the histogram to zero. Samples recorded concurrently
+ * may be lost.
+ */
+static void ssh_latency_hist_reset(struct ssh_latency_hist *h)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(h->counts, cpu), 0, sizeof(*h->counts));
+}
+
+static int ssh_latency_show(struct seq_file *s, void *data)
+{
+	struct ssh_latency_hist *h = s->private;
+	u64 sum[SSH_LATENCY_NUM_BUCKETS];
+	u64 total;
+	int tc, b, cpu;
+
+	seq_puts(s, "# tc: samples per bucket, bucket 0: <1us, bucket n: [2^(n-1), 2^n) us\n");
+
+	for (tc = 0; tc < SSH_LATENCY_NUM_TC; tc++) {
+		memset(sum, 0, sizeof(sum));
+		total = 0;
+
+		for_each_possible_cpu(cpu) {
+			const struct ssh_latency_counts *c = per_cpu_ptr(h->counts, cpu);
+
+			for (b = 0; b < SSH_LATENCY_NUM_BUCKETS; b++)
+				sum[b] += READ_ONCE(c->count[tc][b]);
+		}
+
+		for (b = 0; b < SSH_LATENCY_NUM_BUCKETS; b++)
+			total += sum[b];
+
+		if (!total)
+			continue;
+
+		seq_printf(s, "%#04x:", tc);
+		for (b = 0; b < SSH_LATENCY_NUM_BUCKETS; b++)
+			seq_printf(s, " %llu", sum[b]);
+		seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+
+static int ssh_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ssh_latency_show, inode->i_private);
+}
+
+static ssize_t ssh_latency_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+
+	/* Writing anything resets the histogram. */
+	ssh_latency_hist_reset(s->private);
+	return count;
+}
+
+static const struct file_operations ssh_latency_fops = {
+	.owner   = THIS_MODULE,
+	.open    = ssh_latency_open,
+	.read    = seq_read,
+	.write   = ssh_latency_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * ssh_latency_debugfs_init() - Create debugfs entries for latency statistics.
+ * @lat:    The latency statistics.
+ * @parent: The debugfs directory to create the entries in.
+ *
+ * Creates a "latency" directory in the given parent directory, containing one
+ * file per stage. Reading a file shows the latency histogram of the stage for
+ * each target category with recorded samples, writing to it resets the
+ * histogram. The entries are removed along with the parent directory, which
+ * must happen before the latency statistics are destroyed.
+ */
+void ssh_latency_debugfs_init(struct ssh_latency *lat, struct dentry *parent)
+{
+	struct dentry *dir;
+	int i;
+
+	dir = debugfs_create_dir("latency", parent);
+
+	for (i = 0; i < SSH_LATENCY_NUM_STAGES; i++)
+		debugfs_create_file(ssh_latency_stage_names[i], 0644, dir,
+				    &lat->stage[i], &ssh_latency_fops);
+}
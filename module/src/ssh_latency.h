@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Latency statistics for SSH requests and events.
+ *
+ * Copyright (C) 2019-2022 Maximilian Luz <luzmaximilian@gmail.com>
+ */
+
+#ifndef _SURFACE_AGGREGATOR_SSH_LATENCY_H
+#define _SURFACE_AGGREGATOR_SSH_LATENCY_H
+
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/minmax.h>
+#include <linux/percpu.h>
+#include <linux/types.h>
+
+#include "../include/linux/surface_aggregator/serial_hub.h"
+
+/*
+ * SSH_LATENCY_NUM_TC - Number of target categories tracked separately.
+ *
+ * Covers all currently known target categories (see &enum ssam_ssh_tc).
+ * Latencies of target categories beyond this are accounted to target
+ * category zero, which otherwise only covers requests without target
+ * category (e.g. flush requests).
+ */
+#define SSH_LATENCY_NUM_TC		0x28
+
+/*
+ * SSH_LATENCY_NUM_BUCKETS - Number of histogram buckets.
+ *
+ * Bucket zero counts latencies below one microsecond, bucket n > 0 counts
+ * latencies in the interval [2^(n-1), 2^n) microseconds. The last bucket
+ * additionally counts all latencies beyond its interval.
+ */
+#define SSH_LATENCY_NUM_BUCKETS		24
+
+/**
+ * enum ssh_latency_stage - Stages for which latencies are recorded.
+ *
+ * @SSH_LATENCY_SUBMIT_TX:
+ *	Time from submission of a request to the start of the (last)
+ *	transmission of its packet.
+ *
+ * @SSH_LATENCY_TX_ACK:
+ *	Time from the start of the (last) transmission of the packet of a
+ *	sequenced request to the reception of its ACK.
+ *
+ * @SSH_LATENCY_TX_RESPONSE:
+ *	Time from the start of the (last) transmission of the packet of a
+ *	request to the reception of its response.
+ *
+ * @SSH_LATENCY_EVENT_DISPATCH:
+ *	Time from the reception of an event to its dispatch to the registered
+ *	notifiers.
+ *
+ * @SSH_LATENCY_NUM_STAGES:
+ *	Number of stages.
+ */
+enum ssh_latency_stage {
+	SSH_LATENCY_SUBMIT_TX,
+	SSH_LATENCY_TX_ACK,
+	SSH_LATENCY_TX_RESPONSE,
+	SSH_LATENCY_EVENT_DISPATCH,
+	SSH_LATENCY_NUM_STAGES,
+};
+
+/**
+ * struct ssh_latency_counts - Latency histogram counters of a single CPU.
+ * @count: Number of recorded latencies, indexed by target category and
+ *         histogram bucket.
+ *
+ * Counters are only allocated if debugfs is enabled, as they cannot be read
+ * otherwise.
+ */
+struct ssh_latency_counts {
+	u32 count[SSH_LATENCY_NUM_TC][SSH_LATENCY_NUM_BUCKETS];
+};
+
+/**
+ * struct ssh_latency_hist - Latency histogram of a single stage.
+ * @counts: Per-CPU histogram counters.
+ */
+struct ssh_latency_hist {
+	struct ssh_latency_counts __percpu *counts;
+};
+
+/**
+ * struct ssh_latency - Latency statistics.
+ * @stage: Latency histograms, indexed by &enum ssh_latency_stage.
+ */
+struct ssh_latency {
+	struct ssh_latency_hist stage[SSH_LATENCY_NUM_STAGES];
+};
+
+int ssh_latency_init(struct ssh_latency *lat);
+void ssh_latency_destroy(struct ssh_latency *lat);
+void ssh_latency_debugfs_init(struct ssh_latency *lat, struct dentry *parent);
+
+/**
+ * ssh_latency_record() - Record a latency sample.
+ * @lat:   The latency statistics.
+ * @stage: The stage of the sample.
+ * @tc:    The target category of the sample.
+ * @start: The start time of the sample.
+ * @end:   The end time of the sample.
+ *
+ * Adds the time between @start and @end to the histogram of the given stage
+ * and target category. Only updates counters of the current CPU, thus may be
+ * called from any context without further synchronization. Does nothing if
+ * debugfs is disabled.
+ */
+static inline void ssh_latency_record(struct ssh_latency *lat,
+				      enum ssh_latency_stage stage, u8 tc,
+				      ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+	unsigned int bucket = 0;
+
+	if (!IS_ENABLED(CONFIG_DEBUG_FS))
+		return;
+
+	if (us > 0)
+		bucket = min_t(unsigned int, fls64(us), SSH_LATENCY_NUM_BUCKETS - 1);
+
+	if (tc >= SSH_LATENCY_NUM_TC)
+		tc = 0;
+
+	this_cpu_inc(lat->stage[stage].counts->count[tc][bucket]);
+}
+
+#endif /* _SURFACE_AGGREGATOR_SSH_LATENCY_H */
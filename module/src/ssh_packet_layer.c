@@ -7,22 +7,26 @@
 
 #include <asm/unaligned.h>
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/error-injection.h>
+#include <linux/hrtimer.h>
 #include <linux/jiffies.h>
-#include <linux/kfifo.h>
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/ktime.h>
 #include <linux/limits.h>
 #include <linux/list.h>
 #include <linux/lockdep.h>
+#include <linux/moduleparam.h>
 #include <linux/serdev.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
 
 #include "../include/linux/surface_aggregator/serial_hub.h"
 
+#include "ssh_crc.h"
 #include "ssh_msgb.h"
 #include "ssh_packet_layer.h"
 #include "ssh_parser.h"
@@ -55,49 +59,66 @@
  * packets, containing all packets awaiting an ACK.
  *
  * Shared ownership of a packet is controlled via reference counting. Inside
- * the transport system are a total of five packet owners:
+ * the transport system are a total of four packet owners:
  *
  * - the packet queue,
  * - the pending set,
- * - the transmitter thread,
- * - the receiver thread (via ACKing), and
- * - the timeout work item.
+ * - the transmitter, and
+ * - the receiver thread (via ACKing).
  *
  * Normal operation is as follows: The initial reference of the packet is
- * obtained by submitting the packet and queuing it. The receiver thread takes
+ * obtained by submitting the packet and queuing it. The transmitter takes
  * packets from the queue. By doing this, it does not increment the refcount
  * but takes over the reference (removing it from the queue). If the packet is
- * sequenced (i.e. needs to be ACKed by the client), the transmitter thread
+ * sequenced (i.e. needs to be ACKed by the client), the transmitter
  * sets-up the timeout and adds the packet to the pending set before starting
- * to transmit it. As the timeout is handled by a reaper task, no additional
- * reference for it is needed. After the transmit is done, the reference held
- * by the transmitter thread is dropped. If the packet is unsequenced (i.e.
- * does not need an ACK), the packet is completed by the transmitter thread
- * before dropping that reference.
+ * to transmit it. As timeouts are handled on the pending set by the
+ * transmitter itself, no additional reference for them is needed. After the
+ * transmit is done, the reference held by the transmitter is dropped. If the
+ * packet is unsequenced (i.e. does not need an ACK), the packet is completed
+ * by the transmitter before dropping that reference.
+ *
+ * The transmitter is not a dedicated thread. Instead, packets are transmitted
+ * directly from the submitting context if the transmitter is idle, i.e. its
+ * lock is not held by anyone else. Transmission is only deferred to the
+ * transmitter work item if the transmitter is busy, the underlying serial
+ * device has no space left, or it has been woken up from a context that is
+ * not allowed to sleep (e.g. timers).
  *
  * On receival of an ACK, the receiver thread removes and obtains the
  * reference to the packet from the pending set. The receiver thread will then
- * complete the packet and drop its reference.
+ * complete the packet and drop its reference. ACKs are not cumulative, as the
+ * EC does not treat them as such either: An ACK only acknowledges the packet
+ * with the given sequence ID. Earlier packets that are still pending, e.g.
+ * because either they or their ACK have been lost, are left to the timeout
+ * mechanism described below and will be re-transmitted. To allow the EC to
+ * detect such re-transmissions, the transmitter does not send a new sequenced
+ * packet whose sequence ID lies a full window or more ahead of the oldest
+ * pending packet.
  *
  * On receival of a NAK, the receiver thread re-submits all currently pending
  * packets.
  *
- * Packet timeouts are detected by the timeout reaper. This is a task,
- * scheduled depending on the earliest packet timeout expiration date,
- * checking all currently pending packets if their timeout has expired. If the
- * timeout of a packet has expired, it is re-submitted and the number of tries
- * of this packet is incremented. If this number reaches its limit, the packet
- * will be completed with a failure.
+ * Packet timeouts are detected by a single high-resolution timer, armed with
+ * the earliest expiration date of all pending packets. When it fires, it only
+ * flags the expiration and schedules the transmitter work item. Before
+ * picking up new packets, the transmitter then checks all pending packets
+ * whose timeout has expired (see ssh_ptl_timeout_reap()) and re-arms the
+ * timer for the remaining ones. If the timeout of a packet has expired, it is
+ * re-submitted and the number of tries of this packet is incremented. If
+ * this number reaches its limit, the packet will be completed with a failure.
  *
  * On transmission failure (such as repeated packet timeouts), the completion
- * callback is immediately run by on thread on which the error was detected.
+ * callback is immediately run by the thread on which the error was detected.
+ * As packets are transmitted directly from the submitting context, this may
+ * also be the context of ssh_ptl_submit().
  *
  * To ensure that a packet eventually leaves the system it is marked as
  * "locked" directly before it is going to be completed or when it is
  * canceled. Marking a packet as "locked" has the effect that passing and
  * creating new references of the packet is disallowed. This means that the
  * packet cannot be added to the queue, the pending set, and the timeout, or
- * be picked up by the transmitter thread or receiver thread. To remove a
+ * be picked up by the transmitter or receiver thread. To remove a
  * packet from the system it has to be marked as locked and subsequently all
  * references from the data structures (queue, pending) have to be removed.
  * References held by threads will eventually be dropped automatically as
@@ -192,40 +213,131 @@
  */
 #define SSH_PTL_TX_TIMEOUT			HZ
 
+/*
+ * SSH_PTL_TX_ITERATIONS - Maximum number of batches transmitted per run.
+ *
+ * Maximum number of packet batches the transmitter processes in a single run
+ * before deferring to the transmitter work item. Bounds the time spent
+ * transmitting in submitting contexts and prevents livelocking the workqueue.
+ * Value chosen via educated guess, may be adjusted.
+ */
+#define SSH_PTL_TX_ITERATIONS			4
+
 /*
  * SSH_PTL_PACKET_TIMEOUT - Packet response timeout.
  *
  * Timeout as ktime_t delta for ACKs. If we have not received an ACK in this
  * time-frame after starting transmission, the packet will be re-submitted.
+ * This is the initial timeout, used until the ACK round-trip time has been
+ * measured, and the upper limit for the adaptive timeout.
  */
 #define SSH_PTL_PACKET_TIMEOUT			ms_to_ktime(1000)
 
+/*
+ * SSH_PTL_PACKET_TIMEOUT_MIN - Minimum packet response timeout.
+ *
+ * Lower limit for the adaptive packet timeout derived from the measured ACK
+ * round-trip time. Guards against spurious re-submissions due to jitter and
+ * scheduling delays. As the timeout is doubled on each expiration, a packet
+ * that does not get ACKed at all is failed no earlier than after 1.75s
+ * (250ms + 500ms + 1000ms for %SSH_PTL_MAX_PACKET_TRIES tries), giving a slow
+ * EC time to respond.
+ */
+#define SSH_PTL_PACKET_TIMEOUT_MIN		ms_to_ktime(250)
+
 /*
  * SSH_PTL_PACKET_TIMEOUT_RESOLUTION - Packet timeout granularity.
  *
- * Time-resolution for timeouts. Should be larger than one jiffy to avoid
- * direct re-scheduling of reaper work_struct.
+ * Slack of the timeout timer. Expirations closer together than this may be
+ * handled in a single run.
  */
-#define SSH_PTL_PACKET_TIMEOUT_RESOLUTION	ms_to_ktime(max(2000 / HZ, 50))
+#define SSH_PTL_PACKET_TIMEOUT_RESOLUTION	ms_to_ktime(1)
 
 /*
- * SSH_PTL_MAX_PENDING - Maximum number of pending packets.
+ * SSH_PTL_MAX_PENDING - Default maximum number of pending packets.
  *
- * Maximum number of sequenced packets concurrently waiting for an ACK.
- * Packets marked as blocking will not be transmitted while this limit is
- * reached.
+ * Default maximum number of sequenced packets concurrently waiting for an
+ * ACK, i.e. the default window size. Packets marked as blocking will not be
+ * transmitted while this limit is reached. Can be overridden via the
+ * max_pending_packets module parameter.
  */
 #define SSH_PTL_MAX_PENDING			1
 
+/*
+ * SSH_PTL_MAX_WINDOW - Upper limit for the number of pending packets.
+ *
+ * Upper limit for the window size configured via the max_pending_packets
+ * module parameter. Must be smaller than 128 so that the distance between
+ * the sequence IDs of pending packets is unambiguous, which is required for
+ * limiting the sequence IDs in flight to the window.
+ */
+#define SSH_PTL_MAX_WINDOW			16
+
+/*
+ * SSH_PTL_ACK_MAX_DELAY_US - Upper limit for ACK deferral in microseconds.
+ *
+ * Upper limit for the delay configured via the ack_delay_us module
+ * parameter. Must stay well below the retransmission timeout of the EC.
+ */
+#define SSH_PTL_ACK_MAX_DELAY_US		1000
+
+/*
+ * SSH_PTL_TX_BUF_LEN - Transmitter staging-buffer size in bytes.
+ *
+ * Size of the buffer used to combine multiple packets into a single write.
+ * Packets larger than this are transmitted on their own.
+ */
+#define SSH_PTL_TX_BUF_LEN			1024
+
 /*
  * SSH_PTL_RX_BUF_LEN - Evaluation-buffer size in bytes.
+ *
+ * Size of the buffer used to evaluate messages wrapping around the end of
+ * the receiver ring buffer. This is also the maximum supported message size.
  */
 #define SSH_PTL_RX_BUF_LEN			4096
 
 /*
- * SSH_PTL_RX_FIFO_LEN - Fifo input-buffer size in bytes.
+ * SSH_PTL_RX_RING_LEN - Ring input-buffer size in bytes.
+ *
+ * Must be a power of two and at least SSH_PTL_RX_BUF_LEN so that any
+ * message of supported size can be received completely.
+ */
+#define SSH_PTL_RX_RING_LEN			8192
+
+/*
+ * SSH_PTL_RX_SEQ_WINDOW - Default retransmission detection window.
+ *
+ * Default number of sequence IDs, up to and including the most recently
+ * received one, for which received data packets are considered as
+ * retransmissions of previously received packets. Must be large enough to
+ * cover the retransmission window of the EC, but small enough to not block
+ * sequence IDs that are legitimately re-used after wrapping around. Can be
+ * overridden via the rx_seq_window module parameter, up to
+ * %SSH_SEQ_WINDOW_MAX.
  */
-#define SSH_PTL_RX_FIFO_LEN			4096
+#define SSH_PTL_RX_SEQ_WINDOW			8
+
+static_assert(SSH_PTL_MAX_PENDING <= SSH_PTL_MAX_WINDOW);
+static_assert(SSH_PTL_MAX_WINDOW < 128);
+static_assert(SSH_PTL_RX_RING_LEN >= SSH_PTL_RX_BUF_LEN);
+static_assert(SSH_PTL_RX_SEQ_WINDOW > 0 && SSH_PTL_RX_SEQ_WINDOW <= SSH_SEQ_WINDOW_MAX);
+
+static unsigned int max_pending_packets = SSH_PTL_MAX_PENDING;
+module_param(max_pending_packets, uint, 0444);
+MODULE_PARM_DESC(max_pending_packets, "maximum number of sequenced packets awaiting an ACK (window size, 1 to 16) [default: 1]");
+
+static unsigned int rx_seq_window = SSH_PTL_RX_SEQ_WINDOW;
+module_param(rx_seq_window, uint, 0444);
+MODULE_PARM_DESC(rx_seq_window, "number of recently received sequence IDs for which data packets are treated as retransmissions (1 to 127) [default: 8]");
+
+static unsigned int ack_delay_us;
+module_param(ack_delay_us, uint, 0444);
+MODULE_PARM_DESC(ack_delay_us, "maximum time in microseconds by which ACKs may be deferred to combine them with other data, 0 to disable (0 to 1000) [default: 0]");
+
+static bool rx_fast_path;
+module_param(rx_fast_path, bool, 0444);
+MODULE_PARM_DESC(rx_fast_path, "handle received ACK and NAK frames directly in the receive callback instead of the receiver thread [default: false]");
 
 #ifdef CONFIG_SURFACE_AGGREGATOR_ERROR_INJECTION
 
@@ -577,6 +689,7 @@ void ssh_packet_init(struct ssh_packet *packet, unsigned long type,
 	packet->ptl = NULL;
 	INIT_LIST_HEAD(&packet->queue_node);
 	INIT_LIST_HEAD(&packet->pending_node);
+	INIT_LIST_HEAD(&packet->timeout_node);
 
 	packet->state = type & SSH_PACKET_FLAGS_TY_MASK;
 	packet->priority = priority;
@@ -660,20 +773,150 @@ static const struct ssh_packet_ops ssh_ptl_ctrl_packet_ops = {
 	.release = ssh_ctrl_packet_free,
 };
 
-static void ssh_ptl_timeout_reaper_mod(struct ssh_ptl *ptl, ktime_t now,
-				       ktime_t expires)
+static void ssh_ptl_ctrl_packet_release(struct ssh_packet *p)
+{
+	struct ssh_ptl_ctrl_packet *c = container_of(p, struct ssh_ptl_ctrl_packet, packet);
+	struct ssh_ptl *ptl = p->ptl;
+
+	spin_lock(&ptl->ctrl.lock);
+	__set_bit(c - ptl->ctrl.packets, ptl->ctrl.free);
+	ptl->ctrl.used--;
+	spin_unlock(&ptl->ctrl.lock);
+}
+
+static const struct ssh_packet_ops ssh_ptl_ctrl_pool_packet_ops = {
+	.complete = NULL,
+	.release = ssh_ptl_ctrl_packet_release,
+};
+
+/**
+ * ssh_ptl_ctrl_packet_get() - Get a control packet for transmission.
+ * @ptl:      The packet transport layer.
+ * @priority: The priority of the packet.
+ * @packet:   Where the pointer to the packet should be stored.
+ * @buffer:   The message buffer corresponding to this packet.
+ *
+ * Takes an unused packet from the control packet pool of the given packet
+ * layer and initializes it with the given priority. Falls back to allocating
+ * the packet from the control packet cache if all preallocated packets are
+ * currently in use. In either case, the packet is returned to its origin
+ * when its last reference is dropped.
+ *
+ * Return: Returns zero on success, %-ENOMEM if the pool is exhausted and the
+ * fallback allocation failed.
+ */
+static int ssh_ptl_ctrl_packet_get(struct ssh_ptl *ptl, u8 priority,
+				   struct ssh_packet **packet,
+				   struct ssam_span *buffer)
+{
+	struct ssh_ptl_ctrl_packet *c;
+	unsigned long i;
+	int status;
+
+	spin_lock(&ptl->ctrl.lock);
+
+	i = find_first_bit(ptl->ctrl.free, SSH_PTL_CTRL_POOL_SIZE);
+	if (unlikely(i >= SSH_PTL_CTRL_POOL_SIZE)) {
+		ptl->ctrl.exhausted++;
+		spin_unlock(&ptl->ctrl.lock);
+
+		status = ssh_ctrl_packet_alloc(packet, buffer, GFP_KERNEL);
+		if (status)
+			return status;
+
+		ssh_packet_init(*packet, 0, priority, &ssh_ptl_ctrl_packet_ops);
+		return 0;
+	}
+
+	__clear_bit(i, ptl->ctrl.free);
+	ptl->ctrl.used++;
+	ptl->ctrl.used_max = max(ptl->ctrl.used_max, ptl->ctrl.used);
+
+	spin_unlock(&ptl->ctrl.lock);
+
+	c = &ptl->ctrl.packets[i];
+
+	ssh_packet_init(&c->packet, 0, priority, &ssh_ptl_ctrl_pool_packet_ops);
+	c->packet.ptl = ptl;
+
+	*packet = &c->packet;
+	buffer->ptr = c->buf;
+	buffer->len = ARRAY_SIZE(c->buf);
+
+	return 0;
+}
+
+static void ssh_ptl_ack_release(struct ssh_packet *p)
+{
+	struct ssh_ptl *ptl = to_ssh_ptl(p, ack.packet);
+
+	spin_lock(&ptl->ack.lock);
+	ptl->ack.busy = false;
+	spin_unlock(&ptl->ack.lock);
+}
+
+static const struct ssh_packet_ops ssh_ptl_ack_packet_ops = {
+	.complete = NULL,
+	.release = ssh_ptl_ack_release,
+};
+
+/**
+ * ssh_ptl_rtt_update() - Update the packet timeout from an RTT sample.
+ * @ptl: The packet transport layer.
+ * @rtt: The measured round-trip time, i.e. the time between starting
+ *       transmission of a packet and receiving its ACK.
+ *
+ * Updates the smoothed round-trip time and its variation, following the
+ * estimator specified in RFC 6298, and derives the packet timeout from them.
+ * The timeout is clamped to the range between %SSH_PTL_PACKET_TIMEOUT_MIN and
+ * %SSH_PTL_PACKET_TIMEOUT.
+ */
+static void ssh_ptl_rtt_update(struct ssh_ptl *ptl, ktime_t rtt)
 {
-	unsigned long delta = msecs_to_jiffies(ktime_ms_delta(expires, now));
-	ktime_t aexp = ktime_add(expires, SSH_PTL_PACKET_TIMEOUT_RESOLUTION);
+	ktime_t srtt, rttvar, timeout;
 
 	spin_lock(&ptl->rtx_timeout.lock);
 
-	/* Re-adjust / schedule reaper only if it is above resolution delta. */
-	if (ktime_before(aexp, ptl->rtx_timeout.expires)) {
-		ptl->rtx_timeout.expires = expires;
-		mod_delayed_work(system_wq, &ptl->rtx_timeout.reaper, delta);
+	srtt = ptl->rtx_timeout.srtt;
+	rttvar = ptl->rtx_timeout.rttvar;
+
+	if (!srtt) {
+		/* First measurement. */
+		srtt = rtt;
+		rttvar = rtt >> 1;
+	} else {
+		/* rttvar = 3/4 * rttvar + 1/4 * |srtt - rtt| */
+		rttvar = rttvar - (rttvar >> 2) + (abs(ktime_sub(srtt, rtt)) >> 2);
+		/* srtt = 7/8 * srtt + 1/8 * rtt */
+		srtt = srtt - (srtt >> 3) + (rtt >> 3);
 	}
 
+	timeout = ktime_add(srtt, rttvar << 2);
+	timeout = clamp(timeout, SSH_PTL_PACKET_TIMEOUT_MIN, SSH_PTL_PACKET_TIMEOUT);
+
+	ptl->rtx_timeout.srtt = srtt;
+	ptl->rtx_timeout.rttvar = rttvar;
+	WRITE_ONCE(ptl->rtx_timeout.timeout, timeout);
+
+	spin_unlock(&ptl->rtx_timeout.lock);
+}
+
+/**
+ * ssh_ptl_rtt_backoff() - Back off the packet timeout after a timeout.
+ * @ptl: The packet transport layer.
+ *
+ * Doubles the packet timeout, up to %SSH_PTL_PACKET_TIMEOUT. The timeout will
+ * be re-calculated on the next valid round-trip time measurement.
+ */
+static void ssh_ptl_rtt_backoff(struct ssh_ptl *ptl)
+{
+	ktime_t timeout;
+
+	spin_lock(&ptl->rtx_timeout.lock);
+
+	timeout = min(ptl->rtx_timeout.timeout << 1, SSH_PTL_PACKET_TIMEOUT);
+	WRITE_ONCE(ptl->rtx_timeout.timeout, timeout);
+
 	spin_unlock(&ptl->rtx_timeout.lock);
 }
 
@@ -693,59 +936,66 @@ static void ssh_packet_next_try(struct ssh_packet *p)
 	WRITE_ONCE(p->priority, __SSH_PACKET_PRIORITY(base, try + 1));
 }
 
+/*
+ * Add packet to the tail of the queue bucket corresponding to its priority.
+ * Must be called with queue lock held.
+ *
+ * Packets are taken from the non-empty bucket with the highest priority
+ * first, and in FIFO order inside each bucket. This orders control (ACK/NAK)
+ * packets first, followed by re-submitted data packets (ordered by their
+ * number of tries), and normal data packets last.
+ */
+static void __ssh_ptl_queue_add(struct ssh_packet *p)
+{
+	struct ssh_ptl *ptl = p->ptl;
+
+	lockdep_assert_held(&ptl->queue.lock);
+
+	list_add_tail(&p->queue_node, &ptl->queue.buckets[p->priority]);
+	__set_bit(p->priority, ptl->queue.nonempty);
+}
+
 /* Must be called with queue lock held. */
-static struct list_head *__ssh_ptl_queue_find_entrypoint(struct ssh_packet *p)
+static void __ssh_ptl_queue_del(struct ssh_packet *p)
 {
-	struct list_head *head;
-	struct ssh_packet *q;
+	struct ssh_ptl *ptl = p->ptl;
 
-	lockdep_assert_held(&p->ptl->queue.lock);
+	lockdep_assert_held(&ptl->queue.lock);
 
-	/*
-	 * We generally assume that there are less control (ACK/NAK) packets
-	 * and re-submitted data packets as there are normal data packets (at
-	 * least in situations in which many packets are queued; if there
-	 * aren't many packets queued the decision on how to iterate should be
-	 * basically irrelevant; the number of control/data packets is more or
-	 * less limited via the maximum number of pending packets). Thus, when
-	 * inserting a control or re-submitted data packet, (determined by
-	 * their priority), we search from front to back. Normal data packets
-	 * are, usually queued directly at the tail of the queue, so for those
-	 * search from back to front.
-	 */
+	list_del(&p->queue_node);
 
-	if (p->priority > SSH_PACKET_PRIORITY(DATA, 0)) {
-		list_for_each(head, &p->ptl->queue.head) {
-			q = list_entry(head, struct ssh_packet, queue_node);
+	if (list_empty(&ptl->queue.buckets[p->priority]))
+		__clear_bit(p->priority, ptl->queue.nonempty);
+}
 
-			if (q->priority < p->priority)
-				break;
-		}
-	} else {
-		list_for_each_prev(head, &p->ptl->queue.head) {
-			q = list_entry(head, struct ssh_packet, queue_node);
+/* Must be called with queue lock held. */
+static struct ssh_packet *__ssh_ptl_queue_peek(struct ssh_ptl *ptl)
+{
+	unsigned long bucket;
 
-			if (q->priority >= p->priority) {
-				head = head->next;
-				break;
-			}
-		}
-	}
+	lockdep_assert_held(&ptl->queue.lock);
+
+	bucket = find_last_bit(ptl->queue.nonempty, SSH_PTL_QUEUE_BUCKETS);
+	if (bucket >= SSH_PTL_QUEUE_BUCKETS)
+		return NULL;
 
-	return head;
+	return list_first_entry(&ptl->queue.buckets[bucket], struct ssh_packet,
+				queue_node);
 }
 
 /* Must be called with queue lock held. */
 static int __ssh_ptl_queue_push(struct ssh_packet *packet)
 {
 	struct ssh_ptl *ptl = packet->ptl;
-	struct list_head *head;
 
 	lockdep_assert_held(&ptl->queue.lock);
 
 	if (test_bit(SSH_PTL_SF_SHUTDOWN_BIT, &ptl->state))
 		return -ESHUTDOWN;
 
+	if (WARN_ON(packet->priority >= SSH_PTL_QUEUE_BUCKETS))
+		return -EINVAL;
+
 	/* Avoid further transitions when canceling/completing. */
 	if (test_bit(SSH_PACKET_SF_LOCKED_BIT, &packet->state))
 		return -EINVAL;
@@ -754,9 +1004,7 @@ static int __ssh_ptl_queue_push(struct ssh_packet *packet)
 	if (test_and_set_bit(SSH_PACKET_SF_QUEUED_BIT, &packet->state))
 		return -EALREADY;
 
-	head = __ssh_ptl_queue_find_entrypoint(packet);
-
-	list_add_tail(&ssh_packet_get(packet)->queue_node, head);
+	__ssh_ptl_queue_add(ssh_packet_get(packet));
 	return 0;
 }
 
@@ -782,7 +1030,7 @@ static void ssh_ptl_queue_remove(struct ssh_packet *packet)
 		return;
 	}
 
-	list_del(&packet->queue_node);
+	__ssh_ptl_queue_del(packet);
 
 	spin_unlock(&ptl->queue.lock);
 	ssh_packet_put(packet);
@@ -791,14 +1039,18 @@ static void ssh_ptl_queue_remove(struct ssh_packet *packet)
 static void ssh_ptl_pending_push(struct ssh_packet *p)
 {
 	struct ssh_ptl *ptl = p->ptl;
-	const ktime_t timestamp = ktime_get_coarse_boottime();
-	const ktime_t timeout = ptl->rtx_timeout.timeout;
+	const ktime_t timestamp = ktime_get_boottime();
+	const ktime_t timeout = READ_ONCE(ptl->rtx_timeout.timeout);
 
 	/*
+	 * Note: The timestamp is also used to measure the ACK round-trip
+	 * time, so we use a fine-grained clock here.
+	 *
 	 * Note: We can get the time for the timestamp before acquiring the
 	 * lock as this is the only place we're setting it and this function
-	 * is called only from the transmitter thread. Thus it is not possible
-	 * to overwrite the timestamp with an outdated value below.
+	 * is called only by the transmitter, with the transmitter lock held.
+	 * Thus it is not possible to overwrite the timestamp with an outdated
+	 * value below.
 	 */
 
 	spin_lock(&ptl->pending.lock);
@@ -813,19 +1065,62 @@ static void ssh_ptl_pending_push(struct ssh_packet *p)
 	 * On re-submission, the packet has already been added the pending
 	 * set. We still need to update the timestamp as the packet timeout is
 	 * reset for each (re-)submission.
+	 *
+	 * All packets share the same (current) timeout and timestamps are
+	 * taken from a monotonic clock, so adding the packet at the tail keeps
+	 * the timeout list ordered by expiration date, even if the timeout
+	 * changes.
 	 */
 	p->timestamp = timestamp;
+	list_move_tail(&p->timeout_node, &ptl->pending.timeouts);
 
 	/* In case it is already pending (e.g. re-submission), do not add it. */
 	if (!test_and_set_bit(SSH_PACKET_SF_PENDING_BIT, &p->state)) {
-		atomic_inc(&ptl->pending.count);
+		u8 seq = ssh_packet_get_seq(p);
+
+		/* Guaranteed by ssh_ptl_tx_can_process(). */
+		WARN_ON(ptl->pending.table[seq]);
+
+		if (atomic_inc_return(&ptl->pending.count) == 1)
+			WRITE_ONCE(ptl->pending.oldest, seq);
+
+		ptl->pending.table[seq] = p;
 		list_add_tail(&ssh_packet_get(p)->pending_node, &ptl->pending.head);
 	}
 
 	spin_unlock(&ptl->pending.lock);
 
-	/* Arm/update timeout reaper. */
-	ssh_ptl_timeout_reaper_mod(ptl, timestamp, timestamp + timeout);
+	/* Arm/update timeout. */
+	ssh_timeout_arm(&ptl->rtx_timeout.timer, ktime_add(timestamp, timeout));
+}
+
+/*
+ * Remove packet from pending set, sequence table, and timeout list. Must be
+ * called with pending lock held and after clearing the "pending" bit.
+ */
+static void __ssh_ptl_pending_del(struct ssh_packet *p)
+{
+	struct ssh_ptl *ptl = p->ptl;
+	u8 seq = ssh_packet_get_seq(p);
+
+	lockdep_assert_held(&ptl->pending.lock);
+
+	if (ptl->pending.table[seq] == p)
+		ptl->pending.table[seq] = NULL;
+
+	list_del_init(&p->timeout_node);
+	list_del(&p->pending_node);
+	atomic_dec(&ptl->pending.count);
+
+	if (!list_empty(&ptl->pending.head)) {
+		p = list_first_entry(&ptl->pending.head, struct ssh_packet,
+				     pending_node);
+		WRITE_ONCE(ptl->pending.oldest, ssh_packet_get_seq(p));
+	}
+
+	/* Disarm timeout if there are no more packets waiting for an ACK. */
+	if (list_empty(&ptl->pending.timeouts))
+		ssh_timeout_disarm(&ptl->rtx_timeout.timer);
 }
 
 static void ssh_ptl_pending_remove(struct ssh_packet *packet)
@@ -839,8 +1134,7 @@ static void ssh_ptl_pending_remove(struct ssh_packet *packet)
 		return;
 	}
 
-	list_del(&packet->pending_node);
-	atomic_dec(&ptl->pending.count);
+	__ssh_ptl_pending_del(packet);
 
 	spin_unlock(&ptl->pending.lock);
 
@@ -895,40 +1189,77 @@ static bool ssh_ptl_tx_can_process(struct ssh_packet *packet)
 	if (test_bit(SSH_PACKET_SF_PENDING_BIT, &packet->state))
 		return true;
 
+	/*
+	 * Do not send a sequenced packet while another packet with the same
+	 * sequence ID is still pending, as we could not tell their ACKs
+	 * apart. Pending table entries are only ever added by the transmitter,
+	 * so reading it without holding the pending lock is safe here.
+	 */
+	if (test_bit(SSH_PACKET_TY_SEQUENCED_BIT, &packet->state) &&
+	    READ_ONCE(ptl->pending.table[ssh_packet_get_seq(packet)]))
+		return false;
+
+	/*
+	 * ACKs are not cumulative, so the oldest pending packet may be
+	 * re-transmitted after any number of later packets have been ACKed.
+	 * Keep all sequence IDs in flight inside the window so that the EC
+	 * can still detect this re-transmission. A stale value only makes
+	 * this check more conservative, and the transmitter is woken up
+	 * again once the oldest packet has been ACKed.
+	 */
+	if (test_bit(SSH_PACKET_TY_SEQUENCED_BIT, &packet->state) &&
+	    atomic_read(&ptl->pending.count) &&
+	    (u8)(ssh_packet_get_seq(packet) - READ_ONCE(ptl->pending.oldest)) >=
+	    ptl->pending.max)
+		return false;
+
 	/* Otherwise: Check if we have the capacity to send. */
-	return atomic_read(&ptl->pending.count) < SSH_PTL_MAX_PENDING;
+	return atomic_read(&ptl->pending.count) < ptl->pending.max;
 }
 
-static struct ssh_packet *ssh_ptl_tx_pop(struct ssh_ptl *ptl)
+static struct ssh_packet *ssh_ptl_tx_pop(struct ssh_ptl *ptl, size_t space)
 {
 	struct ssh_packet *packet = ERR_PTR(-ENOENT);
 	struct ssh_packet *p, *n;
+	LIST_HEAD(locked);
 
 	spin_lock(&ptl->queue.lock);
-	list_for_each_entry_safe(p, n, &ptl->queue.head, queue_node) {
+	while ((p = __ssh_ptl_queue_peek(ptl))) {
 		/*
-		 * If we are canceling or completing this packet, ignore it.
-		 * It's going to be removed from this queue shortly.
+		 * If we are canceling or completing this packet, unlink it
+		 * right away so that we do not have to skip it again on the
+		 * next pop. By clearing the "queued" bit, we take over the
+		 * queue reference, which we drop after releasing the lock.
 		 */
-		if (test_bit(SSH_PACKET_SF_LOCKED_BIT, &p->state))
+		if (test_bit(SSH_PACKET_SF_LOCKED_BIT, &p->state)) {
+			__ssh_ptl_queue_del(p);
+			clear_bit(SSH_PACKET_SF_QUEUED_BIT, &p->state);
+			list_add_tail(&p->queue_node, &locked);
 			continue;
+		}
 
 		/*
-		 * Packets should be ordered non-blocking/to-be-resent first.
-		 * If we cannot process this packet, assume that we can't
-		 * process any following packet either and abort.
+		 * Packets are ordered non-blocking/to-be-resent first. If we
+		 * cannot process this packet, assume that we can't process
+		 * any following packet either and abort.
 		 */
 		if (!ssh_ptl_tx_can_process(p)) {
 			packet = ERR_PTR(-EBUSY);
 			break;
 		}
 
+		/* Leave packets that do not fit into the current batch. */
+		if (p->data.len > space) {
+			packet = ERR_PTR(-ENOSPC);
+			break;
+		}
+
 		/*
 		 * We are allowed to change the state now. Remove it from the
 		 * queue and mark it as being transmitted.
 		 */
 
-		list_del(&p->queue_node);
+		__ssh_ptl_queue_del(p);
 
 		set_bit(SSH_PACKET_SF_TRANSMITTING_BIT, &p->state);
 		/* Ensure that state never gets zero. */
@@ -949,14 +1280,20 @@ static struct ssh_packet *ssh_ptl_tx_pop(struct ssh_ptl *ptl)
 	}
 	spin_unlock(&ptl->queue.lock);
 
+	/* Drop the queue references of the locked packets removed above. */
+	list_for_each_entry_safe(p, n, &locked, queue_node) {
+		list_del(&p->queue_node);
+		ssh_packet_put(p);
+	}
+
 	return packet;
 }
 
-static struct ssh_packet *ssh_ptl_tx_next(struct ssh_ptl *ptl)
+static struct ssh_packet *ssh_ptl_tx_next(struct ssh_ptl *ptl, size_t space)
 {
 	struct ssh_packet *p;
 
-	p = ssh_ptl_tx_pop(ptl);
+	p = ssh_ptl_tx_pop(ptl, space);
 	if (IS_ERR(p))
 		return p;
 
@@ -1015,220 +1352,472 @@ static void ssh_ptl_tx_compl_error(struct ssh_packet *packet, int status)
 	wake_up_all(&packet->ptl->tx.packet_wq);
 }
 
-static long ssh_ptl_tx_wait_packet(struct ssh_ptl *ptl)
+/**
+ * ssh_ptl_tx_write() - Write the current batch to the underlying device.
+ * @ptl: The packet transport layer.
+ *
+ * Writes as much of the remaining data of the current batch as the underlying
+ * serial device accepts, without waiting for it to free up space.
+ *
+ * Return: Returns zero if all data of the batch has been written, %-EAGAIN if
+ * the serial device has no space left for the remaining data, or another
+ * negative error code on failure.
+ */
+static int ssh_ptl_tx_write(struct ssh_ptl *ptl)
 {
-	int status;
+	while (ptl->tx.sent < ptl->tx.len) {
+		ssize_t status;
+
+		status = ssh_ptl_write_buf(ptl, ptl->tx.batch[0],
+					   ptl->tx.data + ptl->tx.sent,
+					   ptl->tx.len - ptl->tx.sent);
+		if (status < 0)
+			return status;
+
+		if (status == 0)
+			return -EAGAIN;
+
+		ptl->tx.sent += status;
+		atomic_long_add(status, &ptl->stats.tx_bytes);
+	}
+
+	return 0;
+}
+
+/**
+ * ssh_ptl_tx_take_ack() - Take the deferred ACK for transmission.
+ * @ptl:   The packet transport layer.
+ * @merge: Whether the ACK can be combined with other data, in which case it
+ *         will be taken even if its delay has not yet expired.
+ *
+ * Builds all deferred ACKs in the preallocated ACK packet of the packet layer
+ * and returns it. The returned reference has to be dropped once the packet
+ * has been transmitted. Must only be called with the transmitter lock held.
+ *
+ * Return: Returns the ACK packet, or %NULL if there is no deferred ACK to be
+ * transmitted.
+ */
+static struct ssh_packet *ssh_ptl_tx_take_ack(struct ssh_ptl *ptl, bool merge)
+{
+	struct ssh_packet *p = &ptl->ack.packet;
+	u8 seq[SSH_PTL_ACK_MAX_DEFERRED];
+	struct msgbuf msgb;
+	unsigned int count, i;
 
-	status = wait_for_completion_interruptible(&ptl->tx.thread_cplt_pkt);
-	reinit_completion(&ptl->tx.thread_cplt_pkt);
+	spin_lock(&ptl->ack.lock);
 
 	/*
-	 * Ensure completion is cleared before continuing to avoid lost update
-	 * problems.
+	 * Check the deadline instead of relying on the timer: A timer callback
+	 * for a previous, already taken ACK may still run after the ACK has
+	 * been re-armed and must not cause the new one to be sent early.
 	 */
-	smp_mb__after_atomic();
+	if (!ptl->ack.armed ||
+	    (!merge && ktime_before(ktime_get(), ptl->ack.deadline))) {
+		spin_unlock(&ptl->ack.lock);
+		return NULL;
+	}
 
-	return status;
+	count = ptl->ack.count;
+	memcpy(seq, ptl->ack.seq, count);
+
+	ptl->ack.count = 0;
+	ptl->ack.armed = false;
+	ptl->ack.busy = true;
+
+	spin_unlock(&ptl->ack.lock);
+
+	hrtimer_try_to_cancel(&ptl->ack.timer);
+
+	ssh_packet_init(p, 0, SSH_PACKET_PRIORITY(ACK, 0), &ssh_ptl_ack_packet_ops);
+	p->ptl = ptl;
+	set_bit(SSH_PACKET_SF_TRANSMITTING_BIT, &p->state);
+
+	msgb_init(&msgb, ptl->ack.buf, ARRAY_SIZE(ptl->ack.buf));
+	for (i = 0; i < count; i++)
+		msgb_push_ack(&msgb, seq[i]);
+	ssh_packet_set_data(p, msgb.begin, msgb_bytes_used(&msgb));
+
+	return p;
 }
 
-static long ssh_ptl_tx_wait_transfer(struct ssh_ptl *ptl, long timeout)
+static int ssh_ptl_tx_next_batch(struct ssh_ptl *ptl,
+				 struct ssh_packet **batch, int n)
 {
-	long status;
+	struct ssh_packet *p;
+	size_t len = 0;
+	int count = 0;
+
+	while (count < n) {
+		/*
+		 * Only limit the size of additional packets. A first packet
+		 * that does not fit into the staging buffer is transmitted on
+		 * its own, directly from its buffer.
+		 */
+		p = ssh_ptl_tx_next(ptl, count ? ptl->tx.buf.cap - len : SIZE_MAX);
+		if (IS_ERR(p))
+			break;
 
-	status = wait_for_completion_interruptible_timeout(&ptl->tx.thread_cplt_tx,
-							   timeout);
-	reinit_completion(&ptl->tx.thread_cplt_tx);
+		batch[count++] = p;
+
+		len += p->data.len;
+		if (len > ptl->tx.buf.cap)
+			break;
+	}
 
 	/*
-	 * Ensure completion is cleared before continuing to avoid lost update
-	 * problems.
+	 * Add the deferred ACKs, if any. Combine them with other data if
+	 * possible, otherwise only send them once their delay has expired.
 	 */
-	smp_mb__after_atomic();
+	if (count < n && len + ARRAY_SIZE(ptl->ack.buf) <= ptl->tx.buf.cap) {
+		p = ssh_ptl_tx_take_ack(ptl, count > 0);
+		if (p)
+			batch[count++] = p;
+	}
 
-	return status;
+	return count;
 }
 
-static int ssh_ptl_tx_packet(struct ssh_ptl *ptl, struct ssh_packet *packet)
+static void ssh_ptl_tx_batch_prepare(struct ssh_ptl *ptl, int n)
 {
-	long timeout = SSH_PTL_TX_TIMEOUT;
-	size_t offset = 0;
+	struct ssh_packet *p;
+	size_t len = 0;
+	u8 *data = NULL;
+	int i;
 
-	/* Note: Flush-packets don't have any data. */
-	if (unlikely(!packet->data.ptr))
-		return 0;
+	for (i = 0; i < n; i++) {
+		p = ptl->tx.batch[i];
+		ptl->tx.end[i] = len;
 
-	/* Error injection: drop packet to simulate transmission problem. */
-	if (ssh_ptl_should_drop_packet(packet))
-		return 0;
+		/* Note: Flush-packets don't have any data. */
+		if (unlikely(!p->data.ptr))
+			continue;
 
-	/* Error injection: simulate invalid packet data. */
-	ssh_ptl_tx_inject_invalid_data(packet);
+		/* Error injection: drop packet to simulate transmission problem. */
+		if (ssh_ptl_should_drop_packet(p))
+			continue;
 
-	ptl_dbg(ptl, "tx: sending data (length: %zu)\n", packet->data.len);
-	print_hex_dump_debug("tx: ", DUMP_PREFIX_OFFSET, 16, 1,
-			     packet->data.ptr, packet->data.len, false);
+		/* Error injection: simulate invalid packet data. */
+		ssh_ptl_tx_inject_invalid_data(p);
 
-	do {
-		ssize_t status, len;
-		u8 *buf;
+		/*
+		 * Transmit a single packet directly from its buffer.
+		 * Otherwise, combine all packets in the staging buffer.
+		 */
+		if (n == 1) {
+			data = p->data.ptr;
+		} else {
+			data = ptl->tx.buf.ptr;
+			memcpy(data + len, p->data.ptr, p->data.len);
+		}
 
-		buf = packet->data.ptr + offset;
-		len = packet->data.len - offset;
+		len += p->data.len;
+		ptl->tx.end[i] = len;
+	}
 
-		status = ssh_ptl_write_buf(ptl, packet, buf, len);
-		if (status < 0)
-			return status;
+	ptl->tx.count = n;
+	ptl->tx.data = data;
+	ptl->tx.len = len;
+	ptl->tx.sent = 0;
+	ptl->tx.deadline = jiffies + SSH_PTL_TX_TIMEOUT;
 
-		if (status == len)
-			return 0;
+	if (len) {
+		ptl_dbg(ptl, "tx: sending data (packets: %d, length: %zu)\n", n, len);
+		print_hex_dump_debug("tx: ", DUMP_PREFIX_OFFSET, 16, 1,
+				     data, len, false);
+	}
+}
 
-		offset += status;
+static void ssh_ptl_tx_batch_complete(struct ssh_ptl *ptl, int status)
+{
+	int i;
 
-		timeout = ssh_ptl_tx_wait_transfer(ptl, timeout);
-		if (kthread_should_stop() || !atomic_read(&ptl->tx.running))
-			return -ESHUTDOWN;
+	/*
+	 * Complete packets. On error, packets that have been written
+	 * completely before the error occurred have still been transmitted
+	 * successfully.
+	 */
+	for (i = 0; i < ptl->tx.count; i++) {
+		if (status && ptl->tx.end[i] > ptl->tx.sent) {
+			ssh_ptl_tx_compl_error(ptl->tx.batch[i], status);
+		} else {
+			ssh_ptl_tx_compl_success(ptl->tx.batch[i]);
+			atomic_long_inc(&ptl->stats.tx_frames);
+		}
 
-		if (timeout < 0)
-			return -EINTR;
+		ssh_packet_put(ptl->tx.batch[i]);
+	}
 
-		if (timeout == 0)
-			return -ETIMEDOUT;
-	} while (true);
+	ptl->tx.count = 0;
 }
 
-static int ssh_ptl_tx_threadfn(void *data)
+static void ssh_ptl_timeout_reap(struct ssh_ptl *ptl);
+
+static void ssh_ptl_tx_schedule(struct ssh_ptl *ptl);
+
+/* Must be called with transmitter lock held. */
+static void __ssh_ptl_tx_process(struct ssh_ptl *ptl)
 {
-	struct ssh_ptl *ptl = data;
+	unsigned int iterations = SSH_PTL_TX_ITERATIONS;
+	long remaining;
+	int status;
+	int n;
+
+	lockdep_assert_held(&ptl->tx.lock);
+
+	while (atomic_read(&ptl->tx.running)) {
+		if (!ptl->tx.count) {
+			/*
+			 * Limit the number of batches transmitted in one go
+			 * and leave the rest to the transmitter work item.
+			 */
+			if (!iterations) {
+				ssh_ptl_tx_schedule(ptl);
+				return;
+			}
 
-	while (!kthread_should_stop() && atomic_read(&ptl->tx.running)) {
-		struct ssh_packet *packet;
-		int status;
+			iterations--;
 
-		/* Try to get the next packet. */
-		packet = ssh_ptl_tx_next(ptl);
+			/* Handle expired packets first, re-submitting them if possible. */
+			if (test_and_clear_bit(SSH_PTL_SF_RTX_TIMEOUT_BIT, &ptl->state))
+				ssh_ptl_timeout_reap(ptl);
 
-		/* If no packet can be processed, we are done. */
-		if (IS_ERR(packet)) {
-			ssh_ptl_tx_wait_packet(ptl);
-			continue;
+			/* Try to get the next packets. */
+			n = ssh_ptl_tx_next_batch(ptl, ptl->tx.batch,
+						  ARRAY_SIZE(ptl->tx.batch));
+
+			/* If no packet can be processed, we are done. */
+			if (!n)
+				return;
+
+			ssh_ptl_tx_batch_prepare(ptl, n);
 		}
 
-		/* Transfer and complete packet. */
-		status = ssh_ptl_tx_packet(ptl, packet);
-		if (status)
-			ssh_ptl_tx_compl_error(packet, status);
-		else
-			ssh_ptl_tx_compl_success(packet);
+		/* Transfer as much data as possible. */
+		status = ssh_ptl_tx_write(ptl);
+		if (status == -EAGAIN) {
+			remaining = (long)(ptl->tx.deadline - jiffies);
+
+			/*
+			 * The serial device is full. Continue once it notifies
+			 * us that there is space again, via
+			 * ssh_ptl_tx_wakeup_transfer(), or fail the batch if
+			 * that does not happen in time.
+			 */
+			if (remaining > 0) {
+				queue_delayed_work(system_highpri_wq,
+						   &ptl->tx.work, remaining);
+				return;
+			}
+
+			status = -ETIMEDOUT;
+		}
 
-		ssh_packet_put(packet);
+		/* Complete packets of the batch. */
+		ssh_ptl_tx_batch_complete(ptl, status);
 	}
+}
 
-	return 0;
+static void ssh_ptl_tx_work_fn(struct work_struct *work)
+{
+	struct ssh_ptl *ptl = to_ssh_ptl(work, tx.work.work);
+
+	mutex_lock(&ptl->tx.lock);
+	__ssh_ptl_tx_process(ptl);
+	mutex_unlock(&ptl->tx.lock);
 }
 
 /**
- * ssh_ptl_tx_wakeup_packet() - Wake up packet transmitter thread for new
- * packet.
+ * ssh_ptl_tx_schedule() - Schedule packet transmitter work.
  * @ptl: The packet transport layer.
  *
- * Wakes up the packet transmitter thread, notifying it that a new packet has
- * arrived and is ready for transfer. If the packet transport layer has been
- * shut down, calls to this function will be ignored.
+ * Schedules the transmitter work item to run immediately. If the packet
+ * transport layer has been shut down or the transmitter has not been started,
+ * calls to this function will be ignored.
  */
-static void ssh_ptl_tx_wakeup_packet(struct ssh_ptl *ptl)
+static void ssh_ptl_tx_schedule(struct ssh_ptl *ptl)
 {
 	if (test_bit(SSH_PTL_SF_SHUTDOWN_BIT, &ptl->state))
 		return;
 
-	complete(&ptl->tx.thread_cplt_pkt);
+	if (!atomic_read(&ptl->tx.running))
+		return;
+
+	mod_delayed_work(system_highpri_wq, &ptl->tx.work, 0);
 }
 
 /**
- * ssh_ptl_tx_start() - Start packet transmitter thread.
+ * ssh_ptl_tx_wakeup_packet() - Wake up packet transmitter for new packet.
  * @ptl: The packet transport layer.
  *
- * Return: Returns zero on success, a negative error code on failure.
+ * Notifies the packet transmitter that a new packet has arrived and is ready
+ * for transfer, deferring transmission to the transmitter work item. May be
+ * called from any context.
  */
-int ssh_ptl_tx_start(struct ssh_ptl *ptl)
+static void ssh_ptl_tx_wakeup_packet(struct ssh_ptl *ptl)
 {
-	atomic_set_release(&ptl->tx.running, 1);
-
-	ptl->tx.thread = kthread_run(ssh_ptl_tx_threadfn, ptl, "ssam_serial_hub-tx");
-	if (IS_ERR(ptl->tx.thread))
-		return PTR_ERR(ptl->tx.thread);
-
-	return 0;
+	ssh_ptl_tx_schedule(ptl);
 }
 
 /**
- * ssh_ptl_tx_stop() - Stop packet transmitter thread.
+ * ssh_ptl_tx_process() - Transmit packets directly, if possible.
  * @ptl: The packet transport layer.
  *
- * Return: Returns zero on success, a negative error code on failure.
+ * Transmits queued packets directly from the calling context if the
+ * transmitter is idle, avoiding the context switch to the transmitter work
+ * item. Only if the transmitter is busy, the underlying serial device runs
+ * out of space, or more than %SSH_PTL_TX_ITERATIONS batches of packets are
+ * queued, transmission is deferred to the transmitter work item. Must only be
+ * called from a context that is allowed to sleep.
  */
-int ssh_ptl_tx_stop(struct ssh_ptl *ptl)
+static void ssh_ptl_tx_process(struct ssh_ptl *ptl)
 {
-	int status = 0;
+	if (test_bit(SSH_PTL_SF_SHUTDOWN_BIT, &ptl->state))
+		return;
 
-	if (!IS_ERR_OR_NULL(ptl->tx.thread)) {
-		/* Tell thread to stop. */
-		atomic_set_release(&ptl->tx.running, 0);
+	/*
+	 * If someone else is transmitting, let the work item re-check the
+	 * queue once they are done.
+	 */
+	if (!mutex_trylock(&ptl->tx.lock)) {
+		ssh_ptl_tx_schedule(ptl);
+		return;
+	}
 
-		/*
-		 * Wake up thread in case it is paused. Do not use wakeup
-		 * helpers as this may be called when the shutdown bit has
-		 * already been set.
-		 */
-		complete(&ptl->tx.thread_cplt_pkt);
-		complete(&ptl->tx.thread_cplt_tx);
+	__ssh_ptl_tx_process(ptl);
+	mutex_unlock(&ptl->tx.lock);
+}
 
-		/* Finally, wait for thread to stop. */
-		status = kthread_stop(ptl->tx.thread);
-		ptl->tx.thread = NULL;
-	}
+/**
+ * ssh_ptl_tx_wakeup_transfer() - Wake up packet transmitter for transfer.
+ * @ptl: The packet transport layer.
+ *
+ * Wakes up the packet transmitter, notifying it that the underlying transport
+ * has more space for data to be transmitted. If the packet transport layer
+ * has been shut down, calls to this function will be ignored. May be called
+ * from any context.
+ */
+void ssh_ptl_tx_wakeup_transfer(struct ssh_ptl *ptl)
+{
+	ssh_ptl_tx_schedule(ptl);
+}
 
-	return status;
+/**
+ * ssh_ptl_tx_start() - Start packet transmitter.
+ * @ptl: The packet transport layer.
+ *
+ * Return: Returns zero on success, a negative error code on failure.
+ */
+int ssh_ptl_tx_start(struct ssh_ptl *ptl)
+{
+	atomic_set_release(&ptl->tx.running, 1);
+
+	/* Transmit any packets submitted before the transmitter was started. */
+	ssh_ptl_tx_schedule(ptl);
+
+	return 0;
 }
 
-static struct ssh_packet *ssh_ptl_ack_pop(struct ssh_ptl *ptl, u8 seq_id)
+/**
+ * ssh_ptl_tx_stop() - Stop packet transmitter.
+ * @ptl: The packet transport layer.
+ *
+ * Stops the packet transmitter and waits for any ongoing transmission to
+ * finish. Packets of a partially transmitted batch are completed with
+ * %-ESHUTDOWN as status.
+ *
+ * Return: Returns zero on success, a negative error code on failure.
+ */
+int ssh_ptl_tx_stop(struct ssh_ptl *ptl)
 {
-	struct ssh_packet *packet = ERR_PTR(-ENOENT);
-	struct ssh_packet *p, *n;
+	/* Tell transmitter to stop. */
+	atomic_set_release(&ptl->tx.running, 0);
 
-	spin_lock(&ptl->pending.lock);
-	list_for_each_entry_safe(p, n, &ptl->pending.head, pending_node) {
-		/*
-		 * We generally expect packets to be in order, so first packet
-		 * to be added to pending is first to be sent, is first to be
-		 * ACKed.
-		 */
-		if (unlikely(ssh_packet_get_seq(p) != seq_id))
-			continue;
+	/*
+	 * Wait for any transmission currently in progress. Any transmission
+	 * started after this will see that the transmitter has been stopped
+	 * and bail out before doing anything.
+	 */
+	mutex_lock(&ptl->tx.lock);
+	if (ptl->tx.count)
+		ssh_ptl_tx_batch_complete(ptl, -ESHUTDOWN);
+	mutex_unlock(&ptl->tx.lock);
 
-		/*
-		 * In case we receive an ACK while handling a transmission
-		 * error completion. The packet will be removed shortly.
-		 */
-		if (unlikely(test_bit(SSH_PACKET_SF_LOCKED_BIT, &p->state))) {
-			packet = ERR_PTR(-EPERM);
-			break;
-		}
+	cancel_delayed_work_sync(&ptl->tx.work);
+	return 0;
+}
 
-		/*
-		 * Mark the packet as ACKed and remove it from pending by
-		 * removing its node and decrementing the pending counter.
-		 */
-		set_bit(SSH_PACKET_SF_ACKED_BIT, &p->state);
-		/* Ensure that state never gets zero. */
-		smp_mb__before_atomic();
-		clear_bit(SSH_PACKET_SF_PENDING_BIT, &p->state);
+/* Must be called with pending lock held. */
+static void __ssh_ptl_ack_claim(struct ssh_packet *p)
+{
+	lockdep_assert_held(&p->ptl->pending.lock);
 
-		atomic_dec(&ptl->pending.count);
-		list_del(&p->pending_node);
-		packet = p;
+	/*
+	 * Mark the packet as ACKed and remove it from pending by removing its
+	 * node and decrementing the pending counter.
+	 */
+	set_bit(SSH_PACKET_SF_ACKED_BIT, &p->state);
+	/* Ensure that state never gets zero. */
+	smp_mb__before_atomic();
+	clear_bit(SSH_PACKET_SF_PENDING_BIT, &p->state);
 
-		break;
+	__ssh_ptl_pending_del(p);
+}
+
+/**
+ * ssh_ptl_ack_pop() - Remove the packet acknowledged by an ACK from pending.
+ * @ptl:    The packet transport layer.
+ * @seq_id: The sequence ID of the received ACK.
+ * @rtt:    Where to store the measured round-trip time of the acknowledged
+ *          packet. Set to zero if the packet has been re-transmitted, as the
+ *          ACK cannot be attributed to a specific transmission attempt in
+ *          that case (Karn's algorithm).
+ *
+ * Looks up the pending packet with the given sequence ID in the pending
+ * table and removes it from the pending set, marking it as ACKed. ACKs are
+ * not cumulative, so any other pending packet, including packets transmitted
+ * before the acknowledged one, is left untouched.
+ *
+ * Return: Returns the removed packet on success, passing on its pending
+ * reference to the caller. Returns %-ENOENT if no packet with the given
+ * sequence ID is pending, or %-EPERM if the packet is pending but has been
+ * locked.
+ */
+static struct ssh_packet *ssh_ptl_ack_pop(struct ssh_ptl *ptl, u8 seq_id,
+					  ktime_t *rtt)
+{
+	const ktime_t now = ktime_get_boottime();
+	struct ssh_packet *packet;
+
+	spin_lock(&ptl->pending.lock);
+
+	packet = ptl->pending.table[seq_id];
+	if (unlikely(!packet)) {
+		spin_unlock(&ptl->pending.lock);
+		return ERR_PTR(-ENOENT);
 	}
+
+	/*
+	 * In case we receive an ACK while handling a transmission error
+	 * completion. The packet will be removed shortly.
+	 */
+	if (unlikely(test_bit(SSH_PACKET_SF_LOCKED_BIT, &packet->state))) {
+		spin_unlock(&ptl->pending.lock);
+		return ERR_PTR(-EPERM);
+	}
+
+	/*
+	 * Only sample the round-trip time of packets sent exactly once. The
+	 * try-counter is incremented on each transmission, so this is the
+	 * case if it is one.
+	 */
+	if (ssh_packet_priority_get_try(READ_ONCE(packet->priority)) == 1 &&
+	    packet->timestamp != KTIME_MAX)
+		*rtt = ktime_sub(now, packet->timestamp);
+	else
+		*rtt = 0;
+
+	__ssh_ptl_ack_claim(packet);
+
 	spin_unlock(&ptl->pending.lock);
 
 	return packet;
@@ -1241,30 +1830,9 @@ static void ssh_ptl_wait_until_transmitted(struct ssh_packet *packet)
 		   test_bit(SSH_PACKET_SF_LOCKED_BIT, &packet->state));
 }
 
-static void ssh_ptl_acknowledge(struct ssh_ptl *ptl, u8 seq)
+static void ssh_ptl_acknowledge_packet(struct ssh_ptl *ptl,
+				       struct ssh_packet *p)
 {
-	struct ssh_packet *p;
-
-	p = ssh_ptl_ack_pop(ptl, seq);
-	if (IS_ERR(p)) {
-		if (PTR_ERR(p) == -ENOENT) {
-			/*
-			 * The packet has not been found in the set of pending
-			 * packets.
-			 */
-			ptl_warn(ptl, "ptl: received ACK for non-pending packet\n");
-		} else {
-			/*
-			 * The packet is pending, but we are not allowed to take
-			 * it because it has been locked.
-			 */
-			WARN_ON(PTR_ERR(p) != -EPERM);
-		}
-		return;
-	}
-
-	ptl_dbg(ptl, "ptl: received ACK for packet %p\n", p);
-
 	/*
 	 * It is possible that the packet has been transmitted, but the state
 	 * has not been updated from "transmitting" to "transmitted" yet.
@@ -1291,8 +1859,38 @@ static void ssh_ptl_acknowledge(struct ssh_ptl *ptl, u8 seq)
 
 	ssh_ptl_remove_and_complete(p, 0);
 	ssh_packet_put(p);
+}
+
+static void ssh_ptl_acknowledge(struct ssh_ptl *ptl, u8 seq)
+{
+	struct ssh_packet *p;
+	ktime_t rtt;
+
+	p = ssh_ptl_ack_pop(ptl, seq, &rtt);
+	if (IS_ERR(p)) {
+		if (PTR_ERR(p) == -ENOENT) {
+			/*
+			 * The packet has not been found in the set of pending
+			 * packets.
+			 */
+			ptl_warn(ptl, "ptl: received ACK for non-pending packet\n");
+		} else {
+			/*
+			 * The packet is pending, but we are not allowed to take
+			 * it because it has been locked.
+			 */
+			WARN_ON(PTR_ERR(p) != -EPERM);
+		}
+		return;
+	}
+
+	if (rtt > 0)
+		ssh_ptl_rtt_update(ptl, rtt);
+
+	ptl_dbg(ptl, "ptl: received ACK for packet %p\n", p);
+	ssh_ptl_acknowledge_packet(ptl, p);
 
-	if (atomic_read(&ptl->pending.count) < SSH_PTL_MAX_PENDING)
+	if (atomic_read(&ptl->pending.count) < ptl->pending.max)
 		ssh_ptl_tx_wakeup_packet(ptl);
 }
 
@@ -1304,6 +1902,13 @@ static void ssh_ptl_acknowledge(struct ssh_ptl *ptl, u8 seq)
  * Submits a new packet to the transport layer, queuing it to be sent. This
  * function should not be used for re-submission.
  *
+ * If the transmitter is idle, the packet is transmitted directly from the
+ * calling context, which may sleep. This function must therefore only be
+ * called from a context that is allowed to sleep. Note that, as part of
+ * transmission, completion callbacks of this or other packets may run in
+ * the calling context before this function returns. This includes error
+ * completions, e.g. for failed transmissions or expired packets.
+ *
  * Return: Returns zero on success, %-EINVAL if a packet field is invalid or
  * the packet has been canceled prior to submission, %-EALREADY if the packet
  * has already been submitted, or %-ESHUTDOWN if the packet transport layer
@@ -1314,6 +1919,8 @@ int ssh_ptl_submit(struct ssh_ptl *ptl, struct ssh_packet *p)
 	struct ssh_ptl *ptl_old;
 	int status;
 
+	might_sleep();
+
 	trace_ssam_packet_submit(p);
 
 	/* Validate packet fields. */
@@ -1342,8 +1949,8 @@ int ssh_ptl_submit(struct ssh_ptl *ptl, struct ssh_packet *p)
 		return status;
 
 	if (!test_bit(SSH_PACKET_TY_BLOCKING_BIT, &p->state) ||
-	    (atomic_read(&ptl->pending.count) < SSH_PTL_MAX_PENDING))
-		ssh_ptl_tx_wakeup_packet(ptl);
+	    (atomic_read(&ptl->pending.count) < ptl->pending.max))
+		ssh_ptl_tx_process(ptl);
 
 	return 0;
 }
@@ -1390,8 +1997,11 @@ static int __ssh_ptl_resubmit(struct ssh_packet *packet)
 	}
 
 	packet->timestamp = KTIME_MAX;
+	list_del_init(&packet->timeout_node);
 
 	spin_unlock(&packet->ptl->queue.lock);
+
+	atomic_long_inc(&packet->ptl->stats.retransmissions);
 	return 0;
 }
 
@@ -1418,7 +2028,7 @@ static void ssh_ptl_resubmit_pending(struct ssh_ptl *ptl)
 		/*
 		 * Re-submission fails if the packet is out of tries, has been
 		 * locked, is already queued, or the layer is being shut down.
-		 * No need to re-schedule tx-thread in those cases.
+		 * No need to re-schedule transmitter in those cases.
 		 */
 		if (!__ssh_ptl_resubmit(p))
 			resub = true;
@@ -1478,7 +2088,7 @@ void ssh_ptl_cancel(struct ssh_packet *p)
 	if (READ_ONCE(p->ptl)) {
 		ssh_ptl_remove_and_complete(p, -ECANCELED);
 
-		if (atomic_read(&p->ptl->pending.count) < SSH_PTL_MAX_PENDING)
+		if (atomic_read(&p->ptl->pending.count) < p->ptl->pending.max)
 			ssh_ptl_tx_wakeup_packet(p->ptl);
 
 	} else if (!test_and_set_bit(SSH_PACKET_SF_COMPLETED_BIT, &p->state)) {
@@ -1497,49 +2107,55 @@ static ktime_t ssh_packet_get_expiration(struct ssh_packet *p, ktime_t timeout)
 		return KTIME_MAX;
 }
 
-static void ssh_ptl_timeout_reap(struct work_struct *work)
+/**
+ * ssh_ptl_timeout_reap() - Handle expired packets.
+ * @ptl: The packet transport layer.
+ *
+ * Re-submits packets for which no ACK has been received in time, or cancels
+ * them if they are out of tries, and re-arms the timeout for the remaining
+ * pending packets. Called by the transmitter after the timeout has
+ * expired, so that re-submitted packets can be transmitted directly after.
+ */
+static void ssh_ptl_timeout_reap(struct ssh_ptl *ptl)
 {
-	struct ssh_ptl *ptl = to_ssh_ptl(work, rtx_timeout.reaper.work);
 	struct ssh_packet *p, *n;
 	LIST_HEAD(claimed);
-	ktime_t now = ktime_get_coarse_boottime();
-	ktime_t timeout = ptl->rtx_timeout.timeout;
+	ktime_t now = ktime_get_boottime();
+	ktime_t timeout = READ_ONCE(ptl->rtx_timeout.timeout);
 	ktime_t next = KTIME_MAX;
+	bool expired = false;
 	bool resub = false;
 	int status;
 
 	trace_ssam_ptl_timeout_reap(atomic_read(&ptl->pending.count));
 
-	/*
-	 * Mark reaper as "not pending". This is done before checking any
-	 * packets to avoid lost-update type problems.
-	 */
-	spin_lock(&ptl->rtx_timeout.lock);
-	ptl->rtx_timeout.expires = KTIME_MAX;
-	spin_unlock(&ptl->rtx_timeout.lock);
-
 	spin_lock(&ptl->pending.lock);
 
-	list_for_each_entry_safe(p, n, &ptl->pending.head, pending_node) {
+	/*
+	 * The timeout list is ordered by expiration date, so we only need to
+	 * look at packets up to the first one that has not expired yet.
+	 */
+	list_for_each_entry_safe(p, n, &ptl->pending.timeouts, timeout_node) {
 		ktime_t expires = ssh_packet_get_expiration(p, timeout);
 
 		/*
-		 * Check if the timeout hasn't expired yet. Find out next
-		 * expiration date to be handled after this run.
+		 * Check if the timeout hasn't expired yet. If so, this is the
+		 * next expiration date to be handled after this run.
 		 */
 		if (ktime_after(expires, now)) {
-			next = ktime_before(expires, next) ? expires : next;
-			continue;
+			next = expires;
+			break;
 		}
 
 		trace_ssam_packet_timeout(p);
+		expired = true;
 
 		status = __ssh_ptl_resubmit(p);
 
 		/*
 		 * Re-submission fails if the packet is out of tries, has been
 		 * locked, is already queued, or the layer is being shut down.
-		 * No need to re-schedule tx-thread in those cases.
+		 * No need to re-schedule transmitter in those cases.
 		 */
 		if (!status)
 			resub = true;
@@ -1566,17 +2182,30 @@ static void ssh_ptl_timeout_reap(struct work_struct *work)
 
 		clear_bit(SSH_PACKET_SF_PENDING_BIT, &p->state);
 
-		atomic_dec(&ptl->pending.count);
-		list_move_tail(&p->pending_node, &claimed);
+		__ssh_ptl_pending_del(p);
+		list_add_tail(&p->pending_node, &claimed);
 	}
 
+	/* Re-arm timeout for the next packet to expire. */
+	if (next != KTIME_MAX)
+		ssh_timeout_arm(&ptl->rtx_timeout.timer, next);
+
 	spin_unlock(&ptl->pending.lock);
 
+	/* Back off to avoid re-submitting packets too eagerly. */
+	if (expired)
+		ssh_ptl_rtt_backoff(ptl);
+
+	/* Claimed packets free up pending slots and sequence IDs. */
+	if (!list_empty(&claimed))
+		resub = true;
+
 	/* Cancel and complete the packet. */
 	list_for_each_entry_safe(p, n, &claimed, pending_node) {
 		if (!test_and_set_bit(SSH_PACKET_SF_COMPLETED_BIT, &p->state)) {
 			ssh_ptl_queue_remove(p);
 			__ssh_ptl_complete(p, -ETIMEDOUT);
+			atomic_long_inc(&ptl->stats.timeouts);
 		}
 
 		/*
@@ -1587,19 +2216,21 @@ static void ssh_ptl_timeout_reap(struct work_struct *work)
 		ssh_packet_put(p);
 	}
 
-	/* Ensure that reaper doesn't run again immediately. */
-	next = max(next, ktime_add(now, SSH_PTL_PACKET_TIMEOUT_RESOLUTION));
-	if (next != KTIME_MAX)
-		ssh_ptl_timeout_reaper_mod(ptl, now, next);
-
 	if (resub)
 		ssh_ptl_tx_wakeup_packet(ptl);
 }
 
-static bool ssh_ptl_rx_retransmit_check(struct ssh_ptl *ptl, const struct ssh_frame *frame)
+static void ssh_ptl_timeout_expired(struct ssh_timeout *timeout)
 {
-	int i;
+	struct ssh_ptl *ptl = to_ssh_ptl(timeout, rtx_timeout.timer);
 
+	/* Let the transmitter handle the expired packets. */
+	set_bit(SSH_PTL_SF_RTX_TIMEOUT_BIT, &ptl->state);
+	ssh_ptl_tx_wakeup_packet(ptl);
+}
+
+static bool ssh_ptl_rx_retransmit_check(struct ssh_ptl *ptl, const struct ssh_frame *frame)
+{
 	/*
 	 * Ignore unsequenced packets. On some devices (notably Surface Pro 9),
 	 * unsequenced events will always be sent with SEQ=0x00. Attempting to
@@ -1620,18 +2251,13 @@ static bool ssh_ptl_rx_retransmit_check(struct ssh_ptl *ptl, const struct ssh_fr
 	 * Check if SEQ has been seen recently (i.e. packet was
 	 * re-transmitted and we should ignore it).
 	 */
-	for (i = 0; i < ARRAY_SIZE(ptl->rx.blocked.seqs); i++) {
-		if (likely(ptl->rx.blocked.seqs[i] != frame->seq))
-			continue;
-
+	if (unlikely(ssh_seq_window_test(&ptl->rx.blocked, frame->seq))) {
 		ptl_dbg(ptl, "ptl: ignoring repeated data packet\n");
 		return true;
 	}
 
-	/* Update list of blocked sequence IDs. */
-	ptl->rx.blocked.seqs[ptl->rx.blocked.offset] = frame->seq;
-	ptl->rx.blocked.offset = (ptl->rx.blocked.offset + 1)
-				  % ARRAY_SIZE(ptl->rx.blocked.seqs);
+	/* Update set of blocked sequence IDs. */
+	ssh_seq_window_block(&ptl->rx.blocked, frame->seq);
 
 	return false;
 }
@@ -1646,6 +2272,69 @@ static void ssh_ptl_rx_dataframe(struct ssh_ptl *ptl,
 	ptl->ops.data_received(ptl, payload);
 }
 
+static enum hrtimer_restart ssh_ptl_ack_timer_fn(struct hrtimer *timer)
+{
+	struct ssh_ptl *ptl = to_ssh_ptl(timer, ack.timer);
+
+	/* The transmitter checks whether the deadline has actually passed. */
+	ssh_ptl_tx_wakeup_packet(ptl);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * ssh_ptl_defer_ack() - Defer an ACK to combine it with other data.
+ * @ptl: The packet transport layer.
+ * @seq: The sequence ID to be acknowledged.
+ *
+ * Defers the ACK by at most the configured delay. If the transmitter sends
+ * other data in the meantime, the ACK is sent along with that. Otherwise, it
+ * is sent once the delay expires. ACKs are not cumulative, so each received
+ * packet needs its own ACK: ACKs deferred while other ACKs are already
+ * waiting are added to those and all of them are transmitted together, in
+ * order of reception, with the delay counted from the first one. ACKs for
+ * sequence IDs that are already waiting to be acknowledged are not deferred
+ * twice.
+ *
+ * Return: Returns %true if the ACK has been deferred, %false if it needs to
+ * be sent directly, i.e. because ACK deferral is disabled, the preallocated
+ * ACK packet is currently in use, or the maximum number of deferred ACKs has
+ * been reached.
+ */
+static bool ssh_ptl_defer_ack(struct ssh_ptl *ptl, u8 seq)
+{
+	if (!ptl->ack.delay)
+		return false;
+
+	spin_lock(&ptl->ack.lock);
+
+	if (ptl->ack.busy) {
+		spin_unlock(&ptl->ack.lock);
+		return false;
+	}
+
+	if (memchr(ptl->ack.seq, seq, ptl->ack.count)) {
+		spin_unlock(&ptl->ack.lock);
+		return true;
+	}
+
+	if (ptl->ack.count >= SSH_PTL_ACK_MAX_DEFERRED) {
+		spin_unlock(&ptl->ack.lock);
+		return false;
+	}
+
+	ptl->ack.seq[ptl->ack.count++] = seq;
+
+	if (!ptl->ack.armed) {
+		ptl->ack.armed = true;
+		ptl->ack.deadline = ktime_add(ktime_get(), ptl->ack.delay);
+		hrtimer_start(&ptl->ack.timer, ptl->ack.deadline, HRTIMER_MODE_ABS);
+	}
+
+	spin_unlock(&ptl->ack.lock);
+	return true;
+}
+
 static void ssh_ptl_send_ack(struct ssh_ptl *ptl, u8 seq)
 {
 	struct ssh_packet *packet;
@@ -1653,15 +2342,16 @@ static void ssh_ptl_send_ack(struct ssh_ptl *ptl, u8 seq)
 	struct msgbuf msgb;
 	int status;
 
-	status = ssh_ctrl_packet_alloc(&packet, &buf, GFP_KERNEL);
+	if (ssh_ptl_defer_ack(ptl, seq))
+		return;
+
+	status = ssh_ptl_ctrl_packet_get(ptl, SSH_PACKET_PRIORITY(ACK, 0),
+					 &packet, &buf);
 	if (status) {
 		ptl_err(ptl, "ptl: failed to allocate ACK packet\n");
 		return;
 	}
 
-	ssh_packet_init(packet, 0, SSH_PACKET_PRIORITY(ACK, 0),
-			&ssh_ptl_ctrl_packet_ops);
-
 	msgb_init(&msgb, buf.ptr, buf.len);
 	msgb_push_ack(&msgb, seq);
 	ssh_packet_set_data(packet, msgb.begin, msgb_bytes_used(&msgb));
@@ -1677,48 +2367,149 @@ static void ssh_ptl_send_nak(struct ssh_ptl *ptl)
 	struct msgbuf msgb;
 	int status;
 
-	status = ssh_ctrl_packet_alloc(&packet, &buf, GFP_KERNEL);
+	status = ssh_ptl_ctrl_packet_get(ptl, SSH_PACKET_PRIORITY(NAK, 0),
+					 &packet, &buf);
 	if (status) {
 		ptl_err(ptl, "ptl: failed to allocate NAK packet\n");
 		return;
 	}
 
-	ssh_packet_init(packet, 0, SSH_PACKET_PRIORITY(NAK, 0),
-			&ssh_ptl_ctrl_packet_ops);
-
 	msgb_init(&msgb, buf.ptr, buf.len);
 	msgb_push_nak(&msgb);
 	ssh_packet_set_data(packet, msgb.begin, msgb_bytes_used(&msgb));
 
 	ssh_ptl_submit(ptl, packet);
 	ssh_packet_put(packet);
+
+	atomic_long_inc(&ptl->stats.tx_naks);
+}
+
+/**
+ * ssh_ptl_rx_linearize() - Get a contiguous view of a message in the ring.
+ * @ptl:    The packet transport layer.
+ * @offset: The offset of the message (i.e. its SYN bytes) in the ring buffer.
+ * @len:    The number of bytes available from @offset onwards.
+ * @msg:    The contiguous message data (output).
+ *
+ * If the message is contiguous in the receiver ring buffer, @msg will point
+ * to the data in the ring buffer directly. Only if the message wraps around
+ * the end of the ring buffer, its data will be copied to the evaluation
+ * buffer. This is only done once the message has been received completely,
+ * as the incremental frame parser evaluates partial messages in place.
+ */
+static void ssh_ptl_rx_linearize(struct ssh_ptl *ptl, size_t offset,
+				 size_t len, struct ssam_span *msg)
+{
+	struct ssam_span first, second;
+	size_t payload_len, msg_len, n;
+	u8 *buf = ptl->rx.buf.ptr;
+
+	sshp_ring_span(&ptl->rx.ring, offset, len, &first, &second);
+
+	/* Fast path: Data is contiguous, evaluate it in place. */
+	if (likely(!second.len)) {
+		*msg = first;
+		return;
+	}
+
+	/* Check if the message ends before the end of the ring buffer. */
+	if (first.len >= SSH_MESSAGE_LENGTH(0)) {
+		payload_len = get_unaligned_le16(&first.ptr[SSH_MSGOFFSET_FRAME(len)]);
+
+		if (first.len >= SSH_MESSAGE_LENGTH(payload_len)) {
+			*msg = first;
+			return;
+		}
+	}
+
+	/* Slow path: Message wraps around, copy it to the evaluation buffer. */
+	n = min_t(size_t, len, SSH_MESSAGE_LENGTH(0));
+	sshp_ring_copy(&ptl->rx.ring, offset, buf, n);
+
+	if (n == SSH_MESSAGE_LENGTH(0)) {
+		payload_len = get_unaligned_le16(&buf[SSH_MSGOFFSET_FRAME(len)]);
+		msg_len = SSH_MESSAGE_LENGTH(payload_len);
+
+		if (msg_len <= ptl->rx.buf.cap && msg_len <= len) {
+			sshp_ring_copy(&ptl->rx.ring, offset + n, buf + n,
+				       msg_len - n);
+			n = msg_len;
+		}
+	}
+
+	ptl->rx.buf.len = n;
+	sshp_buf_span_from(&ptl->rx.buf, 0, msg);
+}
+
+static void ssh_ptl_rx_dispatch(struct ssh_ptl *ptl,
+				const struct ssh_frame *frame,
+				const struct ssam_span *payload)
+{
+	trace_ssam_rx_frame_received(frame);
+	atomic_long_inc(&ptl->stats.rx_frames);
+
+	switch (frame->type) {
+	case SSH_FRAME_TYPE_ACK:
+		ssh_ptl_acknowledge(ptl, frame->seq);
+		break;
+
+	case SSH_FRAME_TYPE_NAK:
+		atomic_long_inc(&ptl->stats.rx_naks);
+		ssh_ptl_resubmit_pending(ptl);
+		break;
+
+	case SSH_FRAME_TYPE_DATA_SEQ:
+		ssh_ptl_send_ack(ptl, frame->seq);
+		fallthrough;
+
+	case SSH_FRAME_TYPE_DATA_NSQ:
+		ssh_ptl_rx_dataframe(ptl, frame, payload);
+		break;
+
+	default:
+		ptl_warn(ptl, "ptl: received frame with unknown type %#04x\n",
+			 frame->type);
+		break;
+	}
 }
 
-static size_t ssh_ptl_rx_eval(struct ssh_ptl *ptl, struct ssam_span *source)
+static size_t ssh_ptl_rx_eval(struct ssh_ptl *ptl, size_t offset, size_t len)
 {
+	struct ssam_span first, second;
 	struct ssh_frame *frame;
 	struct ssam_span payload;
 	struct ssam_span aligned;
 	bool syn_found;
+	size_t skip = 0;
 	int status;
 
+	sshp_ring_span(&ptl->rx.ring, offset, len, &first, &second);
+
+	/*
+	 * If the header of the current message has already been validated,
+	 * the message starts at the given offset and we can continue parsing
+	 * where we left off.
+	 */
+	if (sshp_frame_parser_has_header(&ptl->rx.parser))
+		goto parse;
+
 	/* Error injection: Modify data to simulate corrupt SYN bytes. */
-	ssh_ptl_rx_inject_invalid_syn(ptl, source);
+	ssh_ptl_rx_inject_invalid_syn(ptl, &first);
 
 	/* Find SYN. */
-	syn_found = sshp_find_syn(source, &aligned);
+	syn_found = sshp_find_syn_wrapped(&first, &second, &skip);
 
-	if (unlikely(aligned.ptr != source->ptr)) {
+	if (unlikely(skip)) {
 		/*
-		 * We expect aligned.ptr == source->ptr. If this is not the
-		 * case, then aligned.ptr > source->ptr and we've encountered
-		 * some unexpected data where we'd expect the start of a new
-		 * message (i.e. the SYN sequence).
+		 * We expect skip == 0, i.e. the SYN sequence at the start of
+		 * the data. If this is not the case, then skip > 0 and we've
+		 * encountered some unexpected data where we'd expect the start
+		 * of a new message (i.e. the SYN sequence).
 		 *
 		 * This can happen when a CRC check for the previous message
 		 * failed and we start actively searching for the next one
-		 * (via the call to sshp_find_syn() above), or the first bytes
-		 * of a message got dropped or corrupted.
+		 * (via the call to sshp_find_syn_wrapped() above), or the
+		 * first bytes of a message got dropped or corrupted.
 		 *
 		 * In any case, we issue a warning, send a NAK to the EC to
 		 * request re-transmission of any data we haven't acknowledged
@@ -1727,6 +2518,7 @@ static size_t ssh_ptl_rx_eval(struct ssh_ptl *ptl, struct ssam_span *source)
 		 */
 
 		ptl_warn(ptl, "rx: parser: invalid start of frame, skipping\n");
+		atomic_long_inc(&ptl->stats.invalid_syn);
 
 		/*
 		 * Notes:
@@ -1750,74 +2542,87 @@ static size_t ssh_ptl_rx_eval(struct ssh_ptl *ptl, struct ssam_span *source)
 	}
 
 	if (unlikely(!syn_found))
-		return aligned.ptr - source->ptr;
+		return skip;
+
+	sshp_ring_span(&ptl->rx.ring, offset + skip, len - skip, &first, &second);
+
+parse:
+	/* Evaluate newly received data of the message. */
+	status = sshp_frame_parser_feed(&ptl->serdev->dev, &ptl->rx.parser,
+					&first, &second, SSH_PTL_RX_BUF_LEN);
+	if (status < 0) {	/* Invalid frame: skip to next SYN. */
+		if (status == -EBADMSG)
+			atomic_long_inc(&ptl->stats.crc_errors);
+
+		sshp_frame_parser_reset(&ptl->rx.parser);
+		return skip + sizeof(u16);
+	}
+	if (status == 0)	/* Not enough data. */
+		return skip;
+
+	/* Get contiguous message data, copying it only if necessary. */
+	ssh_ptl_rx_linearize(ptl, offset + skip, len - skip, &aligned);
 
 	/* Error injection: Modify data to simulate corruption. */
 	ssh_ptl_rx_inject_invalid_data(ptl, &aligned);
 
-	/* Parse and validate frame. */
-	status = sshp_parse_frame(&ptl->serdev->dev, &aligned, &frame, &payload,
-				  SSH_PTL_RX_BUF_LEN);
-	if (status)	/* Invalid frame: skip to next SYN. */
-		return aligned.ptr - source->ptr + sizeof(u16);
-	if (!frame)	/* Not enough data. */
-		return aligned.ptr - source->ptr;
+	/* Validate payload and parse frame. */
+	status = sshp_frame_parser_finish(&ptl->serdev->dev, &ptl->rx.parser,
+					  &aligned, &frame, &payload);
+	sshp_frame_parser_reset(&ptl->rx.parser);
+	if (status) {	/* Invalid frame: skip to next SYN. */
+		if (status == -EBADMSG)
+			atomic_long_inc(&ptl->stats.crc_errors);
 
-	trace_ssam_rx_frame_received(frame);
+		return skip + sizeof(u16);
+	}
 
-	switch (frame->type) {
-	case SSH_FRAME_TYPE_ACK:
-		ssh_ptl_acknowledge(ptl, frame->seq);
-		break;
+	ssh_ptl_rx_dispatch(ptl, frame, &payload);
 
-	case SSH_FRAME_TYPE_NAK:
-		ssh_ptl_resubmit_pending(ptl);
-		break;
+	return skip + SSH_MESSAGE_LENGTH(payload.len);
+}
 
-	case SSH_FRAME_TYPE_DATA_SEQ:
-		ssh_ptl_send_ack(ptl, frame->seq);
-		fallthrough;
+static void ssh_ptl_rx_dump(struct ssh_ptl *ptl, size_t offset, size_t len)
+{
+	struct ssam_span first, second;
 
-	case SSH_FRAME_TYPE_DATA_NSQ:
-		ssh_ptl_rx_dataframe(ptl, frame, &payload);
-		break;
+	sshp_ring_span(&ptl->rx.ring, offset, len, &first, &second);
 
-	default:
-		ptl_warn(ptl, "ptl: received frame with unknown type %#04x\n",
-			 frame->type);
-		break;
-	}
-
-	return aligned.ptr - source->ptr + SSH_MESSAGE_LENGTH(payload.len);
+	print_hex_dump_debug("rx: ", DUMP_PREFIX_OFFSET, 16, 1,
+			     first.ptr, first.len, false);
+	print_hex_dump_debug("rx: ", DUMP_PREFIX_OFFSET, 16, 1,
+			     second.ptr, second.len, false);
 }
 
 static int ssh_ptl_rx_threadfn(void *data)
 {
 	struct ssh_ptl *ptl = data;
+	size_t seen = 0;
 
 	while (true) {
-		struct ssam_span span;
 		size_t offs = 0;
-		size_t n;
+		size_t len, n;
 
+		/*
+		 * Wait for new data. Data that has already been evaluated
+		 * but could not be parsed yet (i.e. incomplete messages) is
+		 * left in the ring buffer, so only wake up if there is more
+		 * than that.
+		 */
 		wait_event_interruptible(ptl->rx.wq,
-					 !kfifo_is_empty(&ptl->rx.fifo) ||
+					 sshp_ring_used(&ptl->rx.ring) != seen ||
 					 kthread_should_stop());
 		if (kthread_should_stop())
 			break;
 
-		/* Copy from fifo to evaluation buffer. */
-		n = sshp_buf_read_from_fifo(&ptl->rx.buf, &ptl->rx.fifo);
+		len = sshp_ring_used(&ptl->rx.ring);
 
-		ptl_dbg(ptl, "rx: received data (size: %zu)\n", n);
-		print_hex_dump_debug("rx: ", DUMP_PREFIX_OFFSET, 16, 1,
-				     ptl->rx.buf.ptr + ptl->rx.buf.len - n,
-				     n, false);
+		ptl_dbg(ptl, "rx: received data (size: %zu)\n", len - seen);
+		ssh_ptl_rx_dump(ptl, seen, len - seen);
 
-		/* Parse until we need more bytes or buffer is empty. */
-		while (offs < ptl->rx.buf.len) {
-			sshp_buf_span_from(&ptl->rx.buf, offs, &span);
-			n = ssh_ptl_rx_eval(ptl, &span);
+		/* Parse until we need more bytes or all data is evaluated. */
+		while (offs < len) {
+			n = ssh_ptl_rx_eval(ptl, offs, len - offs);
 			if (n == 0)
 				break;	/* Need more bytes. */
 
@@ -1825,7 +2630,8 @@ static int ssh_ptl_rx_threadfn(void *data)
 		}
 
 		/* Throw away the evaluated parts. */
-		sshp_buf_drop(&ptl->rx.buf, offs);
+		sshp_ring_drop(&ptl->rx.ring, offs);
+		seen = len - offs;
 	}
 
 	return 0;
@@ -1873,6 +2679,104 @@ int ssh_ptl_rx_stop(struct ssh_ptl *ptl)
 	return status;
 }
 
+/**
+ * ssh_ptl_rx_fast_parse() - Parse a single ACK or NAK frame for the RX fast
+ * path.
+ * @buf:     The received data, expected to start with a message.
+ * @n:       The number of bytes available.
+ * @frame:   The parsed frame (output).
+ * @payload: The parsed (empty) payload (output).
+ *
+ * Parses and validates the message at the start of the given data, without
+ * logging any errors. Invalid or incomplete messages, as well as messages
+ * other than ACK and NAK frames, are left for the receiver thread to handle.
+ *
+ * Return: Returns the length of the message if it is a complete and valid
+ * ACK or NAK frame, zero otherwise.
+ */
+static size_t ssh_ptl_rx_fast_parse(const u8 *buf, size_t n,
+				    const struct ssh_frame **frame,
+				    struct ssam_span *payload)
+{
+	const u8 *sf = buf + sizeof(u16);
+	const struct ssh_frame *f = (const struct ssh_frame *)sf;
+
+	if (n < SSH_MESSAGE_LENGTH(0) || get_unaligned_le16(buf) != SSH_MSG_SYN)
+		return 0;
+
+	/* ACK and NAK frames never carry a payload. */
+	if (get_unaligned_le16(&f->len) != 0)
+		return 0;
+
+	if (f->type != SSH_FRAME_TYPE_ACK && f->type != SSH_FRAME_TYPE_NAK)
+		return 0;
+
+	/* Validate frame CRC. */
+	if (ssh_crc_compute(sf, sizeof(struct ssh_frame)) !=
+	    get_unaligned_le16(sf + sizeof(struct ssh_frame)))
+		return 0;
+
+	/* Validate payload CRC. */
+	payload->ptr = (u8 *)sf + sizeof(struct ssh_frame) + sizeof(u16);
+	payload->len = 0;
+
+	if (ssh_crc_compute(payload->ptr, 0) != get_unaligned_le16(payload->ptr))
+		return 0;
+
+	*frame = f;
+	return SSH_MESSAGE_LENGTH(0);
+}
+
+/**
+ * ssh_ptl_rx_fast() - Handle received ACK and NAK frames directly.
+ * @ptl: The packet transport layer.
+ * @buf: The received data.
+ * @n:   The number of bytes received.
+ *
+ * Handles complete and valid ACK and NAK frames at the start of the received
+ * data directly from the receive callback of the serial device, avoiding the
+ * hand-off to the receiver thread. This is only done if the receiver thread
+ * is idle, i.e. there is no unevaluated data left in the ring buffer, which
+ * guarantees that frames are still handled in order and that the frame
+ * handlers never run concurrently. Data frames, partial, and invalid frames,
+ * as well as any data following them, are left for the receiver thread.
+ *
+ * Data frames are excluded as handling them may transmit ACKs, run request
+ * and event callbacks, and allocate memory, all of which would stall
+ * reception. Handling an ACK may still complete the acknowledged packet and
+ * may wait for its transmission to finish, and handling a NAK re-submits
+ * pending packets. The receive callback of the serial device runs in process
+ * context, so this is allowed, but it delays reception of further data by
+ * the duration of the packet completion callback.
+ *
+ * Return: Returns the number of bytes handled.
+ */
+static size_t ssh_ptl_rx_fast(struct ssh_ptl *ptl, const u8 *buf, size_t n)
+{
+	const struct ssh_frame *frame;
+	struct ssam_span payload;
+	size_t offs = 0;
+	size_t len;
+
+	if (!sshp_ring_empty(&ptl->rx.ring))
+		return 0;
+
+	while (offs < n) {
+		len = ssh_ptl_rx_fast_parse(buf + offs, n - offs, &frame, &payload);
+		if (!len)
+			break;
+
+		ptl_dbg(ptl, "rx: received data (size: %zu, fast path)\n", len);
+		print_hex_dump_debug("rx: ", DUMP_PREFIX_OFFSET, 16, 1,
+				     buf + offs, len, false);
+
+		ssh_ptl_rx_dispatch(ptl, frame, &payload);
+		offs += len;
+	}
+
+	return offs;
+}
+
 /**
  * ssh_ptl_rx_rcvbuf() - Push data from lower-layer transport to the packet
  * layer.
@@ -1880,25 +2784,38 @@ int ssh_ptl_rx_stop(struct ssh_ptl *ptl)
  * @buf: Pointer to the data to push to the layer.
  * @n:   Size of the data to push to the layer, in bytes.
  *
- * Pushes data from a lower-layer transport to the receiver fifo buffer of the
+ * Pushes data from a lower-layer transport to the receiver ring buffer of the
  * packet layer and notifies the receiver thread. Calls to this function are
  * ignored once the packet layer has been shut down.
  *
+ * If the RX fast path is enabled, complete and valid ACK and NAK frames at the
+ * start of the data are handled directly, without involving the receiver
+ * thread (see ssh_ptl_rx_fast()). Only the remaining data is pushed to the
+ * ring buffer.
+ *
  * Return: Returns the number of bytes transferred (positive or zero) on
  * success. Returns %-ESHUTDOWN if the packet layer has been shut down.
  */
 int ssh_ptl_rx_rcvbuf(struct ssh_ptl *ptl, const u8 *buf, size_t n)
 {
+	size_t fast = 0;
 	int used;
 
 	if (test_bit(SSH_PTL_SF_SHUTDOWN_BIT, &ptl->state))
 		return -ESHUTDOWN;
 
-	used = kfifo_in(&ptl->rx.fifo, buf, n);
-	if (used)
-		ssh_ptl_rx_wakeup(ptl);
+	if (ptl->rx.fast_path)
+		fast = ssh_ptl_rx_fast(ptl, buf, n);
+
+	used = 0;
+	if (fast < n) {
+		used = sshp_ring_write(&ptl->rx.ring, buf + fast, n - fast);
+		if (used)
+			ssh_ptl_rx_wakeup(ptl);
+	}
 
-	return used;
+	atomic_long_add(fast + used, &ptl->stats.rx_bytes);
+	return fast + used;
 }
 
 /**
@@ -1907,7 +2824,7 @@ int ssh_ptl_rx_rcvbuf(struct ssh_ptl *ptl, const u8 *buf, size_t n)
  *
  * Shuts down the packet transport layer, removing and canceling all queued
  * and pending packets. Packets canceled by this operation will be completed
- * with %-ESHUTDOWN as status. Receiver and transmitter threads will be
+ * with %-ESHUTDOWN as status. Receiver thread and transmitter will be
  * stopped.
  *
  * As a result of this function, the transport layer will be marked as shut
@@ -1939,9 +2856,10 @@ void ssh_ptl_shutdown(struct ssh_ptl *ptl)
 
 	status = ssh_ptl_tx_stop(ptl);
 	if (status)
-		ptl_err(ptl, "ptl: failed to stop transmitter thread\n");
+		ptl_err(ptl, "ptl: failed to stop transmitter\n");
 
-	cancel_delayed_work_sync(&ptl->rtx_timeout.reaper);
+	ssh_timeout_cancel_sync(&ptl->rtx_timeout.timer);
+	hrtimer_cancel(&ptl->ack.timer);
 
 	/*
 	 * At this point, all threads have been stopped. This means that the
@@ -1965,13 +2883,14 @@ void ssh_ptl_shutdown(struct ssh_ptl *ptl)
 
 	/* Mark queued packets as locked and move them to complete_q. */
 	spin_lock(&ptl->queue.lock);
-	list_for_each_entry_safe(p, n, &ptl->queue.head, queue_node) {
+	while ((p = __ssh_ptl_queue_peek(ptl))) {
 		set_bit(SSH_PACKET_SF_LOCKED_BIT, &p->state);
 		/* Ensure that state does not get zero. */
 		smp_mb__before_atomic();
 		clear_bit(SSH_PACKET_SF_QUEUED_BIT, &p->state);
 
-		list_move_tail(&p->queue_node, &complete_q);
+		__ssh_ptl_queue_del(p);
+		list_add_tail(&p->queue_node, &complete_q);
 	}
 	spin_unlock(&ptl->queue.lock);
 
@@ -1983,7 +2902,8 @@ void ssh_ptl_shutdown(struct ssh_ptl *ptl)
 		smp_mb__before_atomic();
 		clear_bit(SSH_PACKET_SF_PENDING_BIT, &p->state);
 
-		list_move_tail(&p->pending_node, &complete_q);
+		__ssh_ptl_pending_del(p);
+		list_add_tail(&p->pending_node, &complete_q);
 	}
 	atomic_set(&ptl->pending.count, 0);
 	spin_unlock(&ptl->pending.lock);
@@ -2017,7 +2937,7 @@ void ssh_ptl_shutdown(struct ssh_ptl *ptl)
  * @ops:    Packet layer operations.
  *
  * Initializes the given packet transport layer. Transmitter and receiver
- * threads must be started separately via ssh_ptl_tx_start() and
+ * must be started separately via ssh_ptl_tx_start() and
  * ssh_ptl_rx_start(), after the packet-layer has been initialized and the
  * lower-level transport layer has been set up.
  *
@@ -2032,41 +2952,92 @@ int ssh_ptl_init(struct ssh_ptl *ptl, struct serdev_device *serdev,
 	ptl->state = 0;
 
 	spin_lock_init(&ptl->queue.lock);
-	INIT_LIST_HEAD(&ptl->queue.head);
+	for (i = 0; i < ARRAY_SIZE(ptl->queue.buckets); i++)
+		INIT_LIST_HEAD(&ptl->queue.buckets[i]);
+	bitmap_zero(ptl->queue.nonempty, SSH_PTL_QUEUE_BUCKETS);
 
 	spin_lock_init(&ptl->pending.lock);
 	INIT_LIST_HEAD(&ptl->pending.head);
+	INIT_LIST_HEAD(&ptl->pending.timeouts);
+	memset(ptl->pending.table, 0, sizeof(ptl->pending.table));
 	atomic_set_release(&ptl->pending.count, 0);
+	ptl->pending.max = clamp_t(unsigned int, max_pending_packets, 1,
+				   SSH_PTL_MAX_WINDOW);
 
-	ptl->tx.thread = NULL;
+	mutex_init(&ptl->tx.lock);
 	atomic_set(&ptl->tx.running, 0);
-	init_completion(&ptl->tx.thread_cplt_pkt);
-	init_completion(&ptl->tx.thread_cplt_tx);
+	INIT_DELAYED_WORK(&ptl->tx.work, ssh_ptl_tx_work_fn);
 	init_waitqueue_head(&ptl->tx.packet_wq);
+	ptl->tx.count = 0;
+
+	status = sshp_buf_alloc(&ptl->tx.buf, SSH_PTL_TX_BUF_LEN, GFP_KERNEL);
+	if (status)
+		return status;
 
 	ptl->rx.thread = NULL;
 	init_waitqueue_head(&ptl->rx.wq);
 
+	spin_lock_init(&ptl->ack.lock);
+	ptl->ack.delay = us_to_ktime(min_t(unsigned int, ack_delay_us,
+					   SSH_PTL_ACK_MAX_DELAY_US));
+	ptl->ack.armed = false;
+	ptl->ack.busy = false;
+	ptl->ack.deadline = 0;
+	ptl->ack.count = 0;
+	hrtimer_init(&ptl->ack.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	ptl->ack.timer.function = ssh_ptl_ack_timer_fn;
+
 	spin_lock_init(&ptl->rtx_timeout.lock);
 	ptl->rtx_timeout.timeout = SSH_PTL_PACKET_TIMEOUT;
-	ptl->rtx_timeout.expires = KTIME_MAX;
-	INIT_DELAYED_WORK(&ptl->rtx_timeout.reaper, ssh_ptl_timeout_reap);
+	ptl->rtx_timeout.srtt = 0;
+	ptl->rtx_timeout.rttvar = 0;
+	ssh_timeout_init(&ptl->rtx_timeout.timer, SSH_PTL_PACKET_TIMEOUT_RESOLUTION,
+			 ssh_ptl_timeout_expired);
+
+	spin_lock_init(&ptl->ctrl.lock);
+	bitmap_fill(ptl->ctrl.free, SSH_PTL_CTRL_POOL_SIZE);
+	ptl->ctrl.used = 0;
+	ptl->ctrl.used_max = 0;
+	ptl->ctrl.exhausted = 0;
+
+	atomic_long_set(&ptl->stats.rx_bytes, 0);
+	atomic_long_set(&ptl->stats.rx_frames, 0);
+	atomic_long_set(&ptl->stats.tx_bytes, 0);
+	atomic_long_set(&ptl->stats.tx_frames, 0);
+	atomic_long_set(&ptl->stats.crc_errors, 0);
+	atomic_long_set(&ptl->stats.invalid_syn, 0);
+	atomic_long_set(&ptl->stats.rx_naks, 0);
+	atomic_long_set(&ptl->stats.tx_naks, 0);
+	atomic_long_set(&ptl->stats.retransmissions, 0);
+	atomic_long_set(&ptl->stats.timeouts, 0);
 
 	ptl->ops = *ops;
 
-	/* Initialize list of recent/blocked SEQs with invalid sequence IDs. */
-	for (i = 0; i < ARRAY_SIZE(ptl->rx.blocked.seqs); i++)
-		ptl->rx.blocked.seqs[i] = U16_MAX;
-	ptl->rx.blocked.offset = 0;
+	/* Initialize set of recent/blocked SEQs as empty. */
+	ssh_seq_window_init(&ptl->rx.blocked,
+			    clamp_t(unsigned int, rx_seq_window, 1,
+				    SSH_SEQ_WINDOW_MAX));
+	sshp_frame_parser_reset(&ptl->rx.parser);
+
+	/* Error injection operates on data in the ring buffer only. */
+	ptl->rx.fast_path = rx_fast_path &&
+			    !IS_ENABLED(CONFIG_SURFACE_AGGREGATOR_ERROR_INJECTION);
 
-	status = kfifo_alloc(&ptl->rx.fifo, SSH_PTL_RX_FIFO_LEN, GFP_KERNEL);
+	status = sshp_ring_alloc(&ptl->rx.ring, SSH_PTL_RX_RING_LEN, GFP_KERNEL);
 	if (status)
-		return status;
+		goto err_ring;
 
 	status = sshp_buf_alloc(&ptl->rx.buf, SSH_PTL_RX_BUF_LEN, GFP_KERNEL);
 	if (status)
-		kfifo_free(&ptl->rx.fifo);
+		goto err_buf;
+
+	return 0;
 
+err_buf:
+	sshp_ring_free(&ptl->rx.ring);
+err_ring:
+	sshp_buf_free(&ptl->tx.buf);
+	mutex_destroy(&ptl->tx.lock);
 	return status;
 }
 
@@ -2075,12 +3046,74 @@ int ssh_ptl_init(struct ssh_ptl *ptl, struct serdev_device *serdev,
  * @ptl: The packet transport layer to deinitialize.
  *
  * Deinitializes the given packet transport layer and frees resources
- * associated with it. If receiver and/or transmitter threads have been
- * started, the layer must first be shut down via ssh_ptl_shutdown() before
+ * associated with it. If receiver and/or transmitter have been started, the
+ * layer must first be shut down via ssh_ptl_shutdown() before
  * this function can be called.
  */
 void ssh_ptl_destroy(struct ssh_ptl *ptl)
 {
-	kfifo_free(&ptl->rx.fifo);
+	sshp_ring_free(&ptl->rx.ring);
 	sshp_buf_free(&ptl->rx.buf);
+	sshp_buf_free(&ptl->tx.buf);
+	mutex_destroy(&ptl->tx.lock);
+}
+
+static int ssh_ptl_rtt_show(struct seq_file *s, void *data)
+{
+	struct ssh_ptl *ptl = s->private;
+	ktime_t srtt, rttvar, timeout;
+
+	spin_lock(&ptl->rtx_timeout.lock);
+	srtt = ptl->rtx_timeout.srtt;
+	rttvar = ptl->rtx_timeout.rttvar;
+	timeout = ptl->rtx_timeout.timeout;
+	spin_unlock(&ptl->rtx_timeout.lock);
+
+	seq_printf(s, "srtt_us:    %lld\n", ktime_to_us(srtt));
+	seq_printf(s, "rttvar_us:  %lld\n", ktime_to_us(rttvar));
+	seq_printf(s, "timeout_us: %lld\n", ktime_to_us(timeout));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ssh_ptl_rtt);
+
+static int ssh_ptl_ctrl_pool_show(struct seq_file *s, void *data)
+{
+	struct ssh_ptl *ptl = s->private;
+	unsigned int used, used_max;
+	unsigned long exhausted;
+
+	spin_lock(&ptl->ctrl.lock);
+	used = ptl->ctrl.used;
+	used_max = ptl->ctrl.used_max;
+	exhausted = ptl->ctrl.exhausted;
+	spin_unlock(&ptl->ctrl.lock);
+
+	seq_printf(s, "size:      %u\n", SSH_PTL_CTRL_POOL_SIZE);
+	seq_printf(s, "used:      %u\n", used);
+	seq_printf(s, "used_max:  %u\n", used_max);
+	seq_printf(s, "exhausted: %lu\n", exhausted);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ssh_ptl_ctrl_pool);
+
+/**
+ * ssh_ptl_debugfs_init() - Create debugfs entries for packet transport layer.
+ * @ptl:    The packet transport layer.
+ * @parent: The debugfs directory to create the entries in.
+ *
+ * Creates a "ptl" directory in the given parent directory, exposing the
+ * current ACK round-trip time estimate and packet timeout, as well as usage
+ * statistics of the control packet pool. The entries are
+ * removed along with the parent directory, which must happen before the
+ * packet transport layer is destroyed.
+ */
+void ssh_ptl_debugfs_init(struct ssh_ptl *ptl, struct dentry *parent)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("ptl", parent);
+	debugfs_create_file("rtt", 0444, dir, ptl, &ssh_ptl_rtt_fops);
+	debugfs_create_file("ctrl_pool", 0444, dir, ptl, &ssh_ptl_ctrl_pool_fops);
 }
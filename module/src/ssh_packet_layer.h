@@ -9,9 +9,13 @@
 #define _SURFACE_AGGREGATOR_SSH_PACKET_LAYER_H
 
 #include <linux/atomic.h>
-#include <linux/kfifo.h>
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
 #include <linux/ktime.h>
+#include <linux/limits.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
 #include <linux/serdev.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
@@ -20,6 +24,8 @@
 
 #include "../include/linux/surface_aggregator/serial_hub.h"
 #include "ssh_parser.h"
+#include "ssh_seq_window.h"
+#include "ssh_timeout.h"
 
 /**
  * enum ssh_ptl_state_flags - State-flags for &struct ssh_ptl.
@@ -27,9 +33,59 @@
  * @SSH_PTL_SF_SHUTDOWN_BIT:
  *	Indicates that the packet transport layer has been shut down or is
  *	being shut down and should not accept any new packets/data.
+ *
+ * @SSH_PTL_SF_RTX_TIMEOUT_BIT:
+ *	Indicates that the retransmission timeout has expired and that the
+ *	pending packets need to be checked by the transmitter.
  */
 enum ssh_ptl_state_flags {
 	SSH_PTL_SF_SHUTDOWN_BIT,
+	SSH_PTL_SF_RTX_TIMEOUT_BIT,
+};
+
+/*
+ * SSH_PTL_QUEUE_BUCKETS - Number of priority buckets in the submission queue.
+ *
+ * One bucket per possible packet priority value, i.e. per combination of
+ * base priority and number of tries (see SSH_PACKET_PRIORITY()).
+ */
+#define SSH_PTL_QUEUE_BUCKETS \
+	(__SSH_PACKET_PRIORITY(SSH_PACKET_PRIORITY_ACK, 0x0f) + 1)
+
+/*
+ * SSH_PTL_TX_BATCH - Maximum number of packets transmitted at once.
+ *
+ * Maximum number of packets the transmitter combines into a single write to
+ * the underlying serial device.
+ */
+#define SSH_PTL_TX_BATCH		16
+
+/*
+ * SSH_PTL_ACK_MAX_DEFERRED - Maximum number of deferred ACKs.
+ *
+ * Maximum number of ACKs for different sequence IDs that can be deferred at
+ * the same time. All deferred ACKs are transmitted together in the
+ * preallocated ACK packet. Any further ACK is sent directly.
+ */
+#define SSH_PTL_ACK_MAX_DEFERRED	8
+
+/*
+ * SSH_PTL_CTRL_POOL_SIZE - Number of preallocated control packets.
+ *
+ * Number of control (ACK/NAK) packets preallocated per packet transport
+ * layer. Control packets are only allocated dynamically if all of these are
+ * in use, i.e. waiting for transmission.
+ */
+#define SSH_PTL_CTRL_POOL_SIZE		16
+
+/**
+ * struct ssh_ptl_ctrl_packet - Preallocated control packet.
+ * @packet: The packet.
+ * @buf:    Message buffer of the packet.
+ */
+struct ssh_ptl_ctrl_packet {
+	struct ssh_packet packet;
+	u8 buf[SSH_MSG_LEN_CTRL];
 };
 
 /**
@@ -48,30 +104,98 @@ struct ssh_ptl_ops {
  * @state:         State(-flags) of the transport layer.
  * @queue:         Packet submission queue.
  * @queue.lock:    Lock for modifying the packet submission queue.
- * @queue.head:    List-head of the packet submission queue.
+ * @queue.buckets: Per-priority FIFO lists of the packet submission queue,
+ *                 indexed by packet priority.
+ * @queue.nonempty: Bitmap indicating which priority buckets are non-empty.
  * @pending:       Set/list of pending packets.
  * @pending.lock:  Lock for modifying the pending set.
  * @pending.head:  List-head of the pending set/list.
  * @pending.count: Number of currently pending packets.
+ * @pending.max:   Maximum number of pending packets, i.e. the window size.
+ * @pending.table: Table of pending packets, indexed by sequence ID.
+ * @pending.oldest: Sequence ID of the pending packet transmitted first. Only
+ *                 valid while @pending.count is non-zero.
+ * @pending.timeouts: List of pending packets with active timeout, ordered by
+ *                 expiration date.
  * @tx:            Transmitter subsystem.
- * @tx.running:    Flag indicating (desired) transmitter thread state.
- * @tx.thread:     Transmitter thread.
- * @tx.thread_cplt_tx:  Completion for transmitter thread waiting on transfer.
- * @tx.thread_cplt_pkt: Completion for transmitter thread waiting on packets.
+ * @tx.lock:       Lock serializing transmission. Protects the current batch.
+ * @tx.running:    Flag indicating (desired) transmitter state.
+ * @tx.work:       Work item for transmitting packets that could not be
+ *                 transmitted directly from the submitting context.
  * @tx.packet_wq:  Waitqueue-head for packet transmit completion.
+ * @tx.buf:        Staging buffer for transmitting multiple packets at once.
+ * @tx.batch:      Packets of the batch currently being transmitted.
+ * @tx.end:        End offsets of the packets of the current batch in its data.
+ * @tx.count:      Number of packets in the current batch. Zero if no batch is
+ *                 currently being transmitted.
+ * @tx.data:       Data of the current batch.
+ * @tx.len:        Length of the data of the current batch.
+ * @tx.sent:       Number of bytes of the current batch already written.
+ * @tx.deadline:   Time (in jiffies) by which the current batch must have been
+ *                 written completely.
  * @rx:            Receiver subsystem.
  * @rx.thread:     Receiver thread.
  * @rx.wq:         Waitqueue-head for receiver thread.
- * @rx.fifo:       Buffer for receiving data/pushing data to receiver thread.
- * @rx.buf:        Buffer for evaluating data on receiver thread.
- * @rx.blocked:    List of recent/blocked sequence IDs to detect retransmission.
- * @rx.blocked.seqs:   Array of blocked sequence IDs.
- * @rx.blocked.offset: Offset indicating where a new ID should be inserted.
+ * @rx.ring:       Ring buffer for receiving data/pushing data to receiver
+ *                 thread. Data is evaluated in place by the receiver thread.
+ * @rx.buf:        Buffer for evaluating messages wrapping around the end of
+ *                 the ring buffer on receiver thread.
+ * @rx.blocked:    Window of recent/blocked sequence IDs to detect
+ *                 retransmission.
+ * @rx.parser:     Incremental parser state of the message currently being
+ *                 received, i.e. the message at the start of the ring buffer.
+ * @rx.fast_path:  Whether ACK and NAK frames may be handled directly in the
+ *                 receive callback instead of the receiver thread.
+ * @ack:           Deferred ACK subsystem.
+ * @ack.lock:      Lock for modifying the deferred ACK state.
+ * @ack.delay:     Maximum time by which ACKs may be deferred. Zero if ACKs
+ *                 should not be deferred.
+ * @ack.armed:     Flag indicating that ACKs have been deferred and are waiting
+ *                 to be transmitted.
+ * @ack.busy:      Flag indicating that the ACK packet is currently in use by
+ *                 the transmitter.
+ * @ack.deadline:  Time at which the deferred ACKs have to be transmitted.
+ * @ack.seq:       Sequence IDs to be acknowledged by the deferred ACKs, in
+ *                 order of reception.
+ * @ack.count:     Number of deferred ACKs.
+ * @ack.timer:     Timer for the delay of the deferred ACKs, started when the
+ *                 first of them is deferred.
+ * @ack.packet:    Preallocated packet used to transmit deferred ACKs.
+ * @ack.buf:       Message buffer for the preallocated ACK packet, large enough
+ *                 to hold all deferred ACKs.
+ * @ctrl:          Pool of preallocated control packets.
+ * @ctrl.lock:     Lock for modifying the control packet pool.
+ * @ctrl.free:     Bitmap of control packets currently not in use.
+ * @ctrl.used:     Number of control packets currently in use.
+ * @ctrl.used_max: Maximum number of control packets concurrently in use.
+ * @ctrl.exhausted: Number of times a control packet had to be allocated
+ *                 dynamically because the pool was exhausted.
+ * @ctrl.packets:  The preallocated control packets.
  * @rtx_timeout:   Retransmission timeout subsystem.
- * @rtx_timeout.lock:    Lock for modifying the retransmission timeout reaper.
- * @rtx_timeout.timeout: Timeout interval for retransmission.
- * @rtx_timeout.expires: Time specifying when the reaper work is next scheduled.
- * @rtx_timeout.reaper:  Work performing timeout checks and subsequent actions.
+ * @rtx_timeout.lock:    Lock for modifying the round-trip time estimate.
+ * @rtx_timeout.timeout: Timeout interval for retransmission, derived from the
+ *                       measured ACK round-trip time.
+ * @rtx_timeout.srtt:    Smoothed ACK round-trip time. Zero if no round-trip
+ *                       time has been measured yet.
+ * @rtx_timeout.rttvar:  Variation of the ACK round-trip time.
+ * @rtx_timeout.timer:   Timeout engine, notifying the transmitter when
+ *                       pending packets need to be checked for expiration.
+ * @stats:         Link statistics.
+ * @stats.rx_bytes:        Number of bytes received.
+ * @stats.rx_frames:       Number of valid frames received.
+ * @stats.tx_bytes:        Number of bytes transmitted.
+ * @stats.tx_frames:       Number of packets transmitted, including
+ *                         retransmissions.
+ * @stats.crc_errors:      Number of received frames with invalid header or
+ *                         payload CRC.
+ * @stats.invalid_syn:     Number of times unexpected data has been skipped
+ *                         while searching for the start of a frame.
+ * @stats.rx_naks:         Number of NAKs received.
+ * @stats.tx_naks:         Number of NAKs submitted for transmission.
+ * @stats.retransmissions: Number of packets re-submitted due to a NAK or a
+ *                         timeout.
+ * @stats.timeouts:        Number of packets canceled after running out of
+ *                         tries.
  * @ops:           Packet layer operations.
  */
 struct ssh_ptl {
@@ -80,42 +204,90 @@ struct ssh_ptl {
 
 	struct {
 		spinlock_t lock;
-		struct list_head head;
+		struct list_head buckets[SSH_PTL_QUEUE_BUCKETS];
+		DECLARE_BITMAP(nonempty, SSH_PTL_QUEUE_BUCKETS);
 	} queue;
 
 	struct {
 		spinlock_t lock;
 		struct list_head head;
 		atomic_t count;
+		int max;
+		struct ssh_packet *table[U8_MAX + 1];
+		u8 oldest;
+		struct list_head timeouts;
 	} pending;
 
 	struct {
+		struct mutex lock;
 		atomic_t running;
-		struct task_struct *thread;
-		struct completion thread_cplt_tx;
-		struct completion thread_cplt_pkt;
+		struct delayed_work work;
 		struct wait_queue_head packet_wq;
+		struct sshp_buf buf;
+
+		struct ssh_packet *batch[SSH_PTL_TX_BATCH];
+		size_t end[SSH_PTL_TX_BATCH];
+		int count;
+		const u8 *data;
+		size_t len;
+		size_t sent;
+		unsigned long deadline;
 	} tx;
 
 	struct {
 		struct task_struct *thread;
 		struct wait_queue_head wq;
-		struct kfifo fifo;
+		struct sshp_ring ring;
 		struct sshp_buf buf;
 
-		struct {
-			u16 seqs[8];
-			u16 offset;
-		} blocked;
+		struct ssh_seq_window blocked;
+		struct sshp_frame_parser parser;
+		bool fast_path;
 	} rx;
 
+	struct {
+		spinlock_t lock;
+		ktime_t delay;
+		bool armed;
+		bool busy;
+		ktime_t deadline;
+		u8 seq[SSH_PTL_ACK_MAX_DEFERRED];
+		unsigned int count;
+		struct hrtimer timer;
+		struct ssh_packet packet;
+		u8 buf[SSH_MSG_LEN_CTRL * SSH_PTL_ACK_MAX_DEFERRED];
+	} ack;
+
+	struct {
+		spinlock_t lock;
+		DECLARE_BITMAP(free, SSH_PTL_CTRL_POOL_SIZE);
+		unsigned int used;
+		unsigned int used_max;
+		unsigned long exhausted;
+		struct ssh_ptl_ctrl_packet packets[SSH_PTL_CTRL_POOL_SIZE];
+	} ctrl;
+
 	struct {
 		spinlock_t lock;
 		ktime_t timeout;
-		ktime_t expires;
-		struct delayed_work reaper;
+		ktime_t srtt;
+		ktime_t rttvar;
+		struct ssh_timeout timer;
 	} rtx_timeout;
 
+	struct {
+		atomic_long_t rx_bytes;
+		atomic_long_t rx_frames;
+		atomic_long_t tx_bytes;
+		atomic_long_t tx_frames;
+		atomic_long_t crc_errors;
+		atomic_long_t invalid_syn;
+		atomic_long_t rx_naks;
+		atomic_long_t tx_naks;
+		atomic_long_t retransmissions;
+		atomic_long_t timeouts;
+	} stats;
+
 	struct ssh_ptl_ops ops;
 };
 
@@ -141,6 +313,8 @@ int ssh_ptl_init(struct ssh_ptl *ptl, struct serdev_device *serdev,
 
 void ssh_ptl_destroy(struct ssh_ptl *ptl);
 
+void ssh_ptl_debugfs_init(struct ssh_ptl *ptl, struct dentry *parent);
+
 /**
  * ssh_ptl_get_device() - Get device associated with packet transport layer.
  * @ptl: The packet transport layer.
@@ -164,22 +338,7 @@ void ssh_ptl_cancel(struct ssh_packet *p);
 
 int ssh_ptl_rx_rcvbuf(struct ssh_ptl *ptl, const u8 *buf, size_t n);
 
-/**
- * ssh_ptl_tx_wakeup_transfer() - Wake up packet transmitter thread for
- * transfer.
- * @ptl: The packet transport layer.
- *
- * Wakes up the packet transmitter thread, notifying it that the underlying
- * transport has more space for data to be transmitted. If the packet
- * transport layer has been shut down, calls to this function will be ignored.
- */
-static inline void ssh_ptl_tx_wakeup_transfer(struct ssh_ptl *ptl)
-{
-	if (test_bit(SSH_PTL_SF_SHUTDOWN_BIT, &ptl->state))
-		return;
-
-	complete(&ptl->tx.thread_cplt_tx);
-}
+void ssh_ptl_tx_wakeup_transfer(struct ssh_ptl *ptl);
 
 void ssh_packet_init(struct ssh_packet *packet, unsigned long type,
 		     u8 priority, const struct ssh_packet_ops *ops);
@@ -6,11 +6,15 @@
  */
 
 #include <asm/unaligned.h>
+#include <linux/bitops.h>
 #include <linux/compiler.h>
 #include <linux/device.h>
+#include <linux/minmax.h>
+#include <linux/string.h>
 #include <linux/types.h>
 
 #include "../include/linux/surface_aggregator/serial_hub.h"
+#include "ssh_crc.h"
 #include "ssh_parser.h"
 
 /**
@@ -28,7 +32,7 @@
  */
 static bool sshp_validate_crc(const struct ssam_span *src, const u8 *crc)
 {
-	u16 actual = ssh_crc(src->ptr, src->len);
+	u16 actual = ssh_crc_compute(src->ptr, src->len);
 	u16 expected = get_unaligned_le16(crc);
 
 	return actual == expected;
@@ -68,9 +72,33 @@ static bool sshp_starts_with_syn(const struct ssam_span *src)
  */
 bool sshp_find_syn(const struct ssam_span *src, struct ssam_span *rem)
 {
-	size_t i;
+	const u64 ones = 0x0101010101010101ull;
+	const u64 low7 = 0x7f7f7f7f7f7f7f7full;
+	const u64 syn0 = ones * (SSH_MSG_SYN & 0xff);
+	const u64 syn1 = ones * (SSH_MSG_SYN >> 8);
+	size_t i = 0;
 
-	for (i = 0; i < src->len - 1; i++) {
+	/*
+	 * Scan word-at-a-time: Compare each byte of the word against the first
+	 * SYN byte and each following byte against the second SYN byte. A
+	 * byte of z is zero if and only if both match at its position. The
+	 * last byte of the word has no successor in the word, so advance by
+	 * seven bytes to check it as part of the next word.
+	 */
+	for (; i + 8 <= src->len; i += 7) {
+		u64 w = get_unaligned_le64(src->ptr + i);
+		u64 z = (w ^ syn0) | ((w >> 8) ^ syn1);
+		u64 m = ~(((z & low7) + low7) | z | low7);
+
+		if (m) {
+			i += __ffs64(m) / 8;
+			rem->ptr = src->ptr + i;
+			rem->len = src->len - i;
+			return true;
+		}
+	}
+
+	for (; i < src->len - 1; i++) {
 		if (likely(get_unaligned_le16(src->ptr + i) == SSH_MSG_SYN)) {
 			rem->ptr = src->ptr + i;
 			rem->len = src->len - i;
@@ -90,87 +118,248 @@ bool sshp_find_syn(const struct ssam_span *src, struct ssam_span *rem)
 }
 
 /**
- * sshp_parse_frame() - Parse SSH frame.
- * @dev: The device used for logging.
- * @source: The source to parse from.
- * @frame: The parsed frame (output).
- * @payload: The parsed payload (output).
- * @maxlen: The maximum supported message length.
+ * sshp_find_syn_wrapped() - Find SSH SYN bytes in two-segment data.
+ * @first:  The first segment of the data to search in. Must not be
+ *          zero-length.
+ * @second: The second segment of the data to search in, directly following
+ *          the first one. May be zero-length.
+ * @offset: The offset (output) of the SYN bytes, relative to the start of the
+ *          first segment.
  *
- * Parses and validates a SSH frame, including its payload, from the given
- * source. Sets the provided @frame pointer to the start of the frame and
- * writes the limits of the frame payload to the provided @payload span
- * pointer.
+ * Same as sshp_find_syn(), but searches data split into two segments, e.g.
+ * data wrapping around the end of a ring buffer. SYN bytes may be split
+ * across both segments.
  *
- * This function does not copy any data, but rather only validates the message
- * data and sets pointers (and length values) to indicate the respective parts.
+ * If a complete SSH SYN sequence could be found, @offset is set to its
+ * position. If only partial SSH SYN bytes could be found at the very end of
+ * the data, @offset is set to their position. Otherwise, @offset is set to
+ * the total length of both segments.
  *
- * If no complete SSH frame could be found, the frame pointer will be set to
- * the %NULL pointer and the payload span will be set to the null span (start
- * pointer %NULL, size zero).
- *
- * Return: Returns zero on success or if the frame is incomplete, %-ENOMSG if
- * the start of the message is invalid, %-EBADMSG if any (frame-header or
- * payload) CRC is invalid, or %-EMSGSIZE if the SSH message is bigger than
- * the maximum message length specified in the @maxlen parameter.
+ * Return: Returns %true if a complete SSH SYN sequence could be found,
+ * %false otherwise.
  */
-int sshp_parse_frame(const struct device *dev, const struct ssam_span *source,
-		     struct ssh_frame **frame, struct ssam_span *payload,
-		     size_t maxlen)
+bool sshp_find_syn_wrapped(const struct ssam_span *first,
+			   const struct ssam_span *second, size_t *offset)
 {
-	struct ssam_span sf;
-	struct ssam_span sp;
+	struct ssam_span rem;
+	bool found;
 
-	/* Initialize output. */
-	*frame = NULL;
-	payload->ptr = NULL;
-	payload->len = 0;
+	found = sshp_find_syn(first, &rem);
+	*offset = rem.ptr - first->ptr;
 
-	if (!sshp_starts_with_syn(source)) {
-		dev_warn(dev, "rx: parser: invalid start of frame\n");
-		return -ENOMSG;
-	}
+	if (found || !second->len)
+		return found;
 
-	/* Check for minimum packet length. */
-	if (unlikely(source->len < SSH_MESSAGE_LENGTH(0))) {
-		dev_dbg(dev, "rx: parser: not enough data for frame\n");
-		return 0;
+	/* Check for SYN bytes split across both segments. */
+	if (rem.len && second->ptr[0] == (SSH_MSG_SYN >> 8))
+		return true;
+
+	found = sshp_find_syn(second, &rem);
+	*offset = first->len + (rem.ptr - second->ptr);
+
+	return found;
+}
+
+/*
+ * SSHP_HEADER_LEN - Length of the message header, i.e. SYN bytes, frame, and
+ * frame CRC.
+ */
+#define SSHP_HEADER_LEN		(SSH_MESSAGE_LENGTH(0) - sizeof(u16))
+
+/**
+ * sshp_span2_copy() - Copy data from two-segment source.
+ * @first:  The first segment of the source data.
+ * @second: The second segment of the source data, directly following the
+ *          first one.
+ * @offset: The offset of the data to copy, relative to the start of the first
+ *          segment.
+ * @dst:    The destination buffer.
+ * @len:    The number of bytes to copy. The data must be available in the
+ *          source, i.e. @offset + @len must not exceed the combined length of
+ *          both segments.
+ */
+static void sshp_span2_copy(const struct ssam_span *first,
+			    const struct ssam_span *second, size_t offset,
+			    u8 *dst, size_t len)
+{
+	size_t n = 0;
+
+	if (offset < first->len) {
+		n = min(len, first->len - offset);
+		memcpy(dst, first->ptr + offset, n);
+		offset += n;
 	}
 
-	/* Pin down frame. */
-	sf.ptr = source->ptr + sizeof(u16);
-	sf.len = sizeof(struct ssh_frame);
+	memcpy(dst + n, second->ptr + offset - first->len, len - n);
+}
 
-	/* Validate frame CRC. */
-	if (unlikely(!sshp_validate_crc(&sf, sf.ptr + sf.len))) {
-		dev_warn(dev, "rx: parser: invalid frame CRC\n");
-		return -EBADMSG;
+/**
+ * sshp_span2_crc() - Update CRC with data from two-segment source.
+ * @first:  The first segment of the source data.
+ * @second: The second segment of the source data, directly following the
+ *          first one.
+ * @offset: The offset of the data to process, relative to the start of the
+ *          first segment.
+ * @len:    The number of bytes to process. The data must be available in the
+ *          source, i.e. @offset + @len must not exceed the combined length of
+ *          both segments.
+ * @crc:    The CRC computed over the preceding data.
+ *
+ * Return: Returns the CRC, updated by the specified data.
+ */
+static u16 sshp_span2_crc(const struct ssam_span *first,
+			  const struct ssam_span *second, size_t offset,
+			  size_t len, u16 crc)
+{
+	size_t n = 0;
+
+	if (offset < first->len) {
+		n = min(len, first->len - offset);
+		crc = ssh_crc_update(crc, first->ptr + offset, n);
+		offset += n;
 	}
 
-	/* Ensure packet does not exceed maximum length. */
-	sp.len = get_unaligned_le16(&((struct ssh_frame *)sf.ptr)->len);
-	if (unlikely(SSH_MESSAGE_LENGTH(sp.len) > maxlen)) {
-		dev_warn(dev, "rx: parser: frame too large: %llu bytes\n",
-			 SSH_MESSAGE_LENGTH(sp.len));
-		return -EMSGSIZE;
+	return ssh_crc_update(crc, second->ptr + offset - first->len, len - n);
+}
+
+/**
+ * sshp_frame_parser_feed() - Feed data to incremental SSH frame parser.
+ * @dev:    The device used for logging.
+ * @p:      The parser state.
+ * @first:  The first segment of the message data, starting with the SYN bytes
+ *          of the message.
+ * @second: The second segment of the message data, directly following the
+ *          first one, e.g. data wrapping around the end of a ring buffer. May
+ *          be zero-length.
+ * @maxlen: The maximum supported message length.
+ *
+ * Evaluates the message data provided in @first and @second, all of which
+ * (including any data already seen by previous calls) must start at the same
+ * message. Data that has been evaluated in previous calls for the current
+ * message is not evaluated again: The frame header is validated only once,
+ * as soon as it has been received completely, and the payload CRC is updated
+ * incrementally with newly received data only.
+ *
+ * Once the message has been received completely, it must be validated and
+ * parsed via sshp_frame_parser_finish(). On error or after the message has
+ * been handled, the parser must be reset via sshp_frame_parser_reset() before
+ * it can be used for the next message.
+ *
+ * Return: Returns the length of the message if it has been received
+ * completely, zero if the message is incomplete, %-ENOMSG if the start of the
+ * message is invalid, %-EBADMSG if the frame-header CRC is invalid, or
+ * %-EMSGSIZE if the SSH message is bigger than the maximum message length
+ * specified in the @maxlen parameter.
+ */
+int sshp_frame_parser_feed(const struct device *dev, struct sshp_frame_parser *p,
+			   const struct ssam_span *first,
+			   const struct ssam_span *second, size_t maxlen)
+{
+	size_t len = first->len + second->len;
+	u8 hdr[SSHP_HEADER_LEN];
+	struct ssam_span sh;
+	struct ssam_span sf;
+	size_t end;
+
+	if (!p->valid) {
+		/* Check for minimum header length. */
+		if (len < SSHP_HEADER_LEN) {
+			dev_dbg(dev, "rx: parser: not enough data for frame\n");
+			return 0;
+		}
+
+		/* Get contiguous copy of header. */
+		sshp_span2_copy(first, second, 0, hdr, SSHP_HEADER_LEN);
+		sh.ptr = hdr;
+		sh.len = SSHP_HEADER_LEN;
+
+		if (!sshp_starts_with_syn(&sh)) {
+			dev_warn(dev, "rx: parser: invalid start of frame\n");
+			return -ENOMSG;
+		}
+
+		/* Pin down frame. */
+		sf.ptr = sh.ptr + sizeof(u16);
+		sf.len = sizeof(struct ssh_frame);
+
+		/* Validate frame CRC. */
+		if (unlikely(!sshp_validate_crc(&sf, sf.ptr + sf.len))) {
+			dev_warn(dev, "rx: parser: invalid frame CRC\n");
+			return -EBADMSG;
+		}
+
+		memcpy(&p->frame, sf.ptr, sizeof(p->frame));
+		p->msg_len = SSH_MESSAGE_LENGTH(get_unaligned_le16(&p->frame.len));
+
+		/* Ensure packet does not exceed maximum length. */
+		if (unlikely(p->msg_len > maxlen)) {
+			dev_warn(dev, "rx: parser: frame too large: %zu bytes\n",
+				 p->msg_len);
+			return -EMSGSIZE;
+		}
+
+		p->pos = SSHP_HEADER_LEN;
+		p->crc = 0xffff;
+		p->valid = true;
 	}
 
-	/* Pin down payload. */
-	sp.ptr = sf.ptr + sf.len + sizeof(u16);
+	/* Update payload CRC with newly received payload data. */
+	end = min(len, p->msg_len - sizeof(u16));
+	if (end > p->pos) {
+		p->crc = sshp_span2_crc(first, second, p->pos, end - p->pos, p->crc);
+		p->pos = end;
+	}
 
 	/* Check for frame + payload length. */
-	if (source->len < SSH_MESSAGE_LENGTH(sp.len)) {
+	if (len < p->msg_len) {
 		dev_dbg(dev, "rx: parser: not enough data for payload\n");
 		return 0;
 	}
 
+	return p->msg_len;
+}
+
+/**
+ * sshp_frame_parser_finish() - Validate and parse completely received frame.
+ * @dev:     The device used for logging.
+ * @p:       The parser state. sshp_frame_parser_feed() must have indicated
+ *           that the message has been received completely.
+ * @source:  The contiguous message data, starting with the SYN bytes.
+ * @frame:   The parsed frame (output).
+ * @payload: The parsed payload (output).
+ *
+ * Validates the payload CRC stored in the message against the CRC computed
+ * incrementally by sshp_frame_parser_feed(). Sets the provided @frame pointer
+ * to the start of the frame and writes the limits of the frame payload to the
+ * provided @payload span pointer.
+ *
+ * This function does not copy any data, but rather only validates the message
+ * data and sets pointers (and length values) to indicate the respective parts.
+ *
+ * Return: Returns zero on success or %-EBADMSG if the payload CRC is invalid.
+ */
+int sshp_frame_parser_finish(const struct device *dev,
+			     const struct sshp_frame_parser *p,
+			     const struct ssam_span *source,
+			     struct ssh_frame **frame, struct ssam_span *payload)
+{
+	struct ssam_span sp;
+
+	/* Pin down payload. */
+	sp.ptr = source->ptr + SSHP_HEADER_LEN;
+	sp.len = p->msg_len - SSH_MESSAGE_LENGTH(0);
+
 	/* Validate payload CRC. */
-	if (unlikely(!sshp_validate_crc(&sp, sp.ptr + sp.len))) {
+	if (unlikely(p->crc != get_unaligned_le16(sp.ptr + sp.len))) {
+		*frame = NULL;
+		payload->ptr = NULL;
+		payload->len = 0;
+
 		dev_warn(dev, "rx: parser: invalid payload CRC\n");
 		return -EBADMSG;
 	}
 
-	*frame = (struct ssh_frame *)sf.ptr;
+	*frame = (struct ssh_frame *)(source->ptr + sizeof(u16));
 	*payload = sp;
 
 	dev_dbg(dev, "rx: parser: valid frame found (type: %#04x, len: %u)\n",
@@ -194,7 +383,7 @@ int sshp_parse_frame(const struct device *dev, const struct ssam_span *source,
  * before calling this function.
  *
  * The @source parameter should be the complete frame payload, e.g. returned
- * by the sshp_parse_frame() command.
+ * by the sshp_frame_parser_finish() command.
  *
  * This function does not copy any data, but rather only validates the frame
  * payload data and sets pointers (and length values) to indicate the
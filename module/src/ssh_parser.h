@@ -8,8 +8,10 @@
 #ifndef _SURFACE_AGGREGATOR_SSH_PARSER_H
 #define _SURFACE_AGGREGATOR_SSH_PARSER_H
 
+#include <linux/compiler.h>
 #include <linux/device.h>
-#include <linux/kfifo.h>
+#include <linux/log2.h>
+#include <linux/minmax.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 
@@ -83,69 +85,271 @@ static inline void sshp_buf_free(struct sshp_buf *buf)
 }
 
 /**
- * sshp_buf_drop() - Drop data from the beginning of the buffer.
- * @buf: The buffer to drop data from.
- * @n:   The number of bytes to drop.
+ * sshp_buf_span_from() - Initialize a span from the given buffer and offset.
+ * @buf:    The buffer to create the span from.
+ * @offset: The offset in the buffer at which the span should start.
+ * @span:   The span to initialize (output).
+ *
+ * Initializes the provided span to point to the memory at the given offset in
+ * the buffer, with the length of the span being capped by the number of bytes
+ * used in the buffer after the offset (i.e. bytes remaining after the
+ * offset).
  *
- * Drops the first @n bytes from the buffer. Re-aligns any remaining data to
- * the beginning of the buffer.
+ * Warning: This function does not validate that @offset is less than or equal
+ * to the number of bytes used in the buffer or the buffer capacity. This must
+ * be guaranteed by the caller.
  */
-static inline void sshp_buf_drop(struct sshp_buf *buf, size_t n)
+static inline void sshp_buf_span_from(struct sshp_buf *buf, size_t offset,
+				      struct ssam_span *span)
 {
-	memmove(buf->ptr, buf->ptr + n, buf->len - n);
-	buf->len -= n;
+	span->ptr = buf->ptr + offset;
+	span->len = buf->len - offset;
 }
 
 /**
- * sshp_buf_read_from_fifo() - Transfer data from a fifo to the buffer.
- * @buf:  The buffer to write the data into.
- * @fifo: The fifo to read the data from.
+ * struct sshp_ring - Ring buffer for received SSH message data.
+ * @ptr:  Pointer to the memory backing the ring buffer.
+ * @cap:  Capacity of the ring buffer. Must be a power of two.
+ * @head: Free-running write index. Only modified by the producer.
+ * @tail: Free-running read index. Only modified by the consumer.
  *
- * Transfers the data contained in the fifo to the buffer, removing it from
- * the fifo. This function will try to transfer as much data as possible,
- * limited either by the remaining space in the buffer or by the number of
- * bytes available in the fifo.
+ * Single-producer single-consumer ring buffer. Data is written to the ring by
+ * the producer via sshp_ring_write() and evaluated in place by the consumer,
+ * which accesses it via sshp_ring_span() and releases it via sshp_ring_drop()
+ * once it has been processed. No locking is required as long as there is
+ * only one concurrent producer and one concurrent consumer.
+ */
+struct sshp_ring {
+	u8    *ptr;
+	size_t cap;
+	size_t head;
+	size_t tail;
+};
+
+/**
+ * sshp_ring_alloc() - Allocate and initialize a SSH parser ring buffer.
+ * @ring:  The ring buffer to initialize/allocate to.
+ * @cap:   The desired capacity of the ring buffer. Must be a power of two.
+ * @flags: The flags used for allocating the memory.
  *
- * Return: Returns the number of bytes transferred.
+ * Return: Returns zero on success, %-EINVAL if the capacity is not a power of
+ * two, and %-ENOMEM if allocation failed.
  */
-static inline size_t sshp_buf_read_from_fifo(struct sshp_buf *buf,
-					     struct kfifo *fifo)
+static inline int sshp_ring_alloc(struct sshp_ring *ring, size_t cap,
+				  gfp_t flags)
 {
-	size_t n;
+	if (WARN_ON(!is_power_of_2(cap)))
+		return -EINVAL;
+
+	ring->ptr = kzalloc(cap, flags);
+	if (!ring->ptr)
+		return -ENOMEM;
 
-	n =  kfifo_out(fifo, buf->ptr + buf->len, buf->cap - buf->len);
-	buf->len += n;
+	ring->cap = cap;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+/**
+ * sshp_ring_free() - Free a SSH parser ring buffer.
+ * @ring: The ring buffer to free.
+ *
+ * Frees a ring buffer previously allocated with sshp_ring_alloc().
+ */
+static inline void sshp_ring_free(struct sshp_ring *ring)
+{
+	kfree(ring->ptr);
+	ring->ptr = NULL;
+	ring->cap = 0;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+/**
+ * sshp_ring_used() - Get the number of bytes available to the consumer.
+ * @ring: The ring buffer.
+ *
+ * Must only be called by the consumer.
+ *
+ * Return: Returns the number of bytes written to the ring buffer that have
+ * not been dropped yet.
+ */
+static inline size_t sshp_ring_used(struct sshp_ring *ring)
+{
+	/* Pairs with smp_store_release() in sshp_ring_write(). */
+	return smp_load_acquire(&ring->head) - ring->tail;
+}
+
+/**
+ * sshp_ring_empty() - Check if all data has been consumed.
+ * @ring: The ring buffer.
+ *
+ * Must only be called by the producer. If this returns %true, the consumer
+ * has dropped all data previously written and any accesses of the consumer
+ * prior to that are visible to the caller.
+ *
+ * Return: Returns %true if the ring buffer does not contain any data.
+ */
+static inline bool sshp_ring_empty(struct sshp_ring *ring)
+{
+	/* Pairs with smp_store_release() in sshp_ring_drop(). */
+	return smp_load_acquire(&ring->tail) == ring->head;
+}
+
+/**
+ * sshp_ring_write() - Write data to the ring buffer.
+ * @ring: The ring buffer to write the data into.
+ * @buf:  The data to write.
+ * @n:    The number of bytes to write.
+ *
+ * Copies as much of the given data as fits into the free space of the ring
+ * buffer and publishes it to the consumer. Must only be called by the
+ * producer.
+ *
+ * Return: Returns the number of bytes written.
+ */
+static inline size_t sshp_ring_write(struct sshp_ring *ring, const u8 *buf,
+				     size_t n)
+{
+	/* Pairs with smp_store_release() in sshp_ring_drop(). */
+	size_t tail = smp_load_acquire(&ring->tail);
+	size_t head = ring->head;
+	size_t off = head & (ring->cap - 1);
+	size_t k;
+
+	n = min(n, ring->cap - (head - tail));
+	k = min(n, ring->cap - off);
+
+	memcpy(ring->ptr + off, buf, k);
+	memcpy(ring->ptr, buf + k, n - k);
+
+	/* Ensure that the data is visible before publishing it. */
+	smp_store_release(&ring->head, head + n);
 
 	return n;
 }
 
 /**
- * sshp_buf_span_from() - Initialize a span from the given buffer and offset.
- * @buf:    The buffer to create the span from.
- * @offset: The offset in the buffer at which the span should start.
- * @span:   The span to initialize (output).
+ * sshp_ring_drop() - Drop data from the beginning of the ring buffer.
+ * @ring: The ring buffer to drop data from.
+ * @n:    The number of bytes to drop.
  *
- * Initializes the provided span to point to the memory at the given offset in
- * the buffer, with the length of the span being capped by the number of bytes
- * used in the buffer after the offset (i.e. bytes remaining after the
- * offset).
+ * Releases the first @n bytes to the producer. Must only be called by the
+ * consumer. Spans previously obtained for the dropped data must not be
+ * accessed any more after this call.
+ */
+static inline void sshp_ring_drop(struct sshp_ring *ring, size_t n)
+{
+	/* Ensure that we are done reading before releasing the space. */
+	smp_store_release(&ring->tail, ring->tail + n);
+}
+
+/**
+ * sshp_ring_span() - Get the contiguous segments of a range in the ring.
+ * @ring:   The ring buffer.
+ * @offset: The offset of the range, relative to the start of the data.
+ * @len:    The length of the range.
+ * @first:  The first segment of the range (output).
+ * @second: The second segment of the range (output). Zero-length if the
+ *          range does not wrap around the end of the ring buffer.
  *
- * Warning: This function does not validate that @offset is less than or equal
- * to the number of bytes used in the buffer or the buffer capacity. This must
- * be guaranteed by the caller.
+ * Does not copy any data, but rather only sets pointers to the respective
+ * parts of the ring buffer. Must only be called by the consumer and only for
+ * data actually available to it (see sshp_ring_used()).
  */
-static inline void sshp_buf_span_from(struct sshp_buf *buf, size_t offset,
-				      struct ssam_span *span)
+static inline void sshp_ring_span(const struct sshp_ring *ring, size_t offset,
+				  size_t len, struct ssam_span *first,
+				  struct ssam_span *second)
 {
-	span->ptr = buf->ptr + offset;
-	span->len = buf->len - offset;
+	size_t off = (ring->tail + offset) & (ring->cap - 1);
+	size_t k = min(len, ring->cap - off);
+
+	first->ptr = ring->ptr + off;
+	first->len = k;
+
+	second->ptr = ring->ptr;
+	second->len = len - k;
+}
+
+/**
+ * sshp_ring_copy() - Copy a range from the ring into a linear buffer.
+ * @ring:   The ring buffer.
+ * @offset: The offset of the range, relative to the start of the data.
+ * @dst:    The buffer to copy to.
+ * @len:    The length of the range.
+ *
+ * Same restrictions as for sshp_ring_span() apply.
+ */
+static inline void sshp_ring_copy(const struct sshp_ring *ring, size_t offset,
+				  u8 *dst, size_t len)
+{
+	struct ssam_span first, second;
+
+	sshp_ring_span(ring, offset, len, &first, &second);
+
+	memcpy(dst, first.ptr, first.len);
+	memcpy(dst + first.len, second.ptr, second.len);
+}
+
+/**
+ * struct sshp_frame_parser - Incremental SSH frame parser state.
+ * @valid:   Flag indicating that the frame header has been validated.
+ * @frame:   Copy of the validated frame header.
+ * @msg_len: Total length of the message, including SYN bytes and CRCs.
+ * @pos:     Number of message bytes evaluated so far, i.e. the offset up to
+ *           which the payload has been fed into @crc.
+ * @crc:     Running CRC over the payload bytes evaluated so far.
+ *
+ * Keeps track of a partially received message so that its data only needs to
+ * be evaluated once, regardless of how many chunks it is received in. All
+ * fields except @valid are only meaningful if @valid is set.
+ */
+struct sshp_frame_parser {
+	bool valid;
+	struct ssh_frame frame;
+	size_t msg_len;
+	size_t pos;
+	u16 crc;
+};
+
+/**
+ * sshp_frame_parser_reset() - Reset incremental SSH frame parser.
+ * @p: The parser state to reset.
+ *
+ * Discards any cached state of the current message, causing the next call to
+ * sshp_frame_parser_feed() to start parsing a new message.
+ */
+static inline void sshp_frame_parser_reset(struct sshp_frame_parser *p)
+{
+	p->valid = false;
+}
+
+/**
+ * sshp_frame_parser_has_header() - Check if the frame header has been parsed.
+ * @p: The parser state.
+ *
+ * Return: Returns %true if the parser has validated the header of the current
+ * message and is waiting for the rest of it, %false otherwise.
+ */
+static inline bool sshp_frame_parser_has_header(const struct sshp_frame_parser *p)
+{
+	return p->valid;
 }
 
 bool sshp_find_syn(const struct ssam_span *src, struct ssam_span *rem);
 
-int sshp_parse_frame(const struct device *dev, const struct ssam_span *source,
-		     struct ssh_frame **frame, struct ssam_span *payload,
-		     size_t maxlen);
+bool sshp_find_syn_wrapped(const struct ssam_span *first,
+			   const struct ssam_span *second, size_t *offset);
+
+int sshp_frame_parser_feed(const struct device *dev, struct sshp_frame_parser *p,
+			   const struct ssam_span *first,
+			   const struct ssam_span *second, size_t maxlen);
+
+int sshp_frame_parser_finish(const struct device *dev,
+			     const struct sshp_frame_parser *p,
+			     const struct ssam_span *source,
+			     struct ssh_frame **frame, struct ssam_span *payload);
 
 int sshp_parse_command(const struct device *dev, const struct ssam_span *source,
 		       struct ssh_command **command,
@@ -9,9 +9,13 @@
 #include <linux/atomic.h>
 #include <linux/completion.h>
 #include <linux/error-injection.h>
+#include <linux/hashtable.h>
 #include <linux/ktime.h>
 #include <linux/limits.h>
 #include <linux/list.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/preempt.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
@@ -22,6 +26,7 @@
 
 #include "ssh_packet_layer.h"
 #include "ssh_request_layer.h"
+#include "ssh_timeout.h"
 
 #include "trace.h"
 
@@ -38,20 +43,29 @@
 /*
  * SSH_RTL_REQUEST_TIMEOUT_RESOLUTION - Request timeout granularity.
  *
- * Time-resolution for timeouts. Should be larger than one jiffy to avoid
- * direct re-scheduling of reaper work_struct.
+ * Slack of the timeout timer. Expirations closer together than this may be
+ * handled in a single run.
  */
-#define SSH_RTL_REQUEST_TIMEOUT_RESOLUTION	ms_to_ktime(max(2000 / HZ, 50))
+#define SSH_RTL_REQUEST_TIMEOUT_RESOLUTION	ms_to_ktime(10)
 
 /*
- * SSH_RTL_MAX_PENDING - Maximum number of pending requests.
+ * SSH_RTL_MAX_PENDING - Default maximum number of pending requests.
  *
- * Maximum number of requests concurrently waiting to be completed (i.e.
- * waiting for the corresponding packet transmission to finish if they don't
- * have a response or waiting for a response if they have one).
+ * Default maximum number of requests concurrently waiting to be completed
+ * (i.e. waiting for the corresponding packet transmission to finish if they
+ * don't have a response or waiting for a response if they have one). Can be
+ * overridden via the max_pending_requests module parameter.
  */
 #define SSH_RTL_MAX_PENDING		3
 
+/*
+ * SSH_RTL_MAX_WINDOW - Upper limit for the number of pending requests.
+ *
+ * Upper limit for the number of pending requests configured via the
+ * max_pending_requests module parameter.
+ */
+#define SSH_RTL_MAX_WINDOW		32
+
 /*
  * SSH_RTL_TX_BATCH - Maximum number of requests processed per work execution.
  * Used to prevent livelocking of the workqueue. Value chosen via educated
@@ -59,6 +73,12 @@
  */
 #define SSH_RTL_TX_BATCH		10
 
+static_assert(SSH_RTL_MAX_PENDING <= SSH_RTL_MAX_WINDOW);
+
+static unsigned int max_pending_requests = SSH_RTL_MAX_PENDING;
+module_param(max_pending_requests, uint, 0444);
+MODULE_PARM_DESC(max_pending_requests, "maximum number of requests awaiting completion (1 to 32) [default: 3]");
+
 #ifdef CONFIG_SURFACE_AGGREGATOR_ERROR_INJECTION
 
 /**
@@ -97,6 +117,15 @@ static u32 ssh_request_get_rqid_safe(struct ssh_request *rqst)
 	return ssh_request_get_rqid(rqst);
 }
 
+static u8 ssh_request_get_tc(struct ssh_request *rqst)
+{
+	/* Flush requests do not have any data and thus no target category. */
+	if (!rqst->packet.data.ptr)
+		return 0;
+
+	return rqst->packet.data.ptr[SSH_MSGOFFSET_COMMAND(tc)];
+}
+
 static void ssh_rtl_queue_remove(struct ssh_request *rqst)
 {
 	struct ssh_rtl *rtl = ssh_request_rtl(rqst);
@@ -138,6 +167,11 @@ static void ssh_rtl_pending_remove(struct ssh_request *rqst)
 
 	atomic_dec(&rtl->pending.count);
 	list_del(&rqst->node);
+	hash_del(&rqst->hash_node);
+
+	/* Disarm timeout if there are no more pending requests. */
+	if (list_empty(&rtl->pending.head))
+		ssh_timeout_disarm(&rtl->rtx_timeout.timer);
 
 	spin_unlock(&rtl->pending.lock);
 
@@ -162,6 +196,8 @@ static int ssh_rtl_tx_pending_push(struct ssh_request *rqst)
 
 	atomic_inc(&rtl->pending.count);
 	list_add_tail(&ssh_request_get(rqst)->node, &rtl->pending.head);
+	hash_add(rtl->pending.table, &rqst->hash_node,
+		 ssh_request_get_rqid_safe(rqst));
 
 	spin_unlock(&rtl->pending.lock);
 	return 0;
@@ -201,7 +237,7 @@ static bool ssh_rtl_tx_can_process(struct ssh_request *rqst)
 	if (test_bit(SSH_REQUEST_TY_FLUSH_BIT, &rqst->state))
 		return !atomic_read(&rtl->pending.count);
 
-	return atomic_read(&rtl->pending.count) < SSH_RTL_MAX_PENDING;
+	return atomic_read(&rtl->pending.count) < rtl->pending.max;
 }
 
 static struct ssh_request *ssh_rtl_tx_next(struct ssh_rtl *rtl)
@@ -302,32 +338,43 @@ static int ssh_rtl_tx_try_process_one(struct ssh_rtl *rtl)
 	return 0;
 }
 
-static bool ssh_rtl_tx_schedule(struct ssh_rtl *rtl)
+static bool ssh_rtl_tx_can_schedule(struct ssh_rtl *rtl)
 {
-	if (atomic_read(&rtl->pending.count) >= SSH_RTL_MAX_PENDING)
+	if (atomic_read(&rtl->pending.count) >= rtl->pending.max)
 		return false;
 
-	if (ssh_rtl_queue_empty(rtl))
+	return !ssh_rtl_queue_empty(rtl);
+}
+
+static bool ssh_rtl_tx_schedule(struct ssh_rtl *rtl)
+{
+	if (!ssh_rtl_tx_can_schedule(rtl))
 		return false;
 
-	return schedule_work(&rtl->tx.work);
+	return queue_work(system_highpri_wq, &rtl->tx.work);
 }
 
-static void ssh_rtl_tx_work_fn(struct work_struct *work)
+/*
+ * Must be called with transmitter lock held. Returns true if there may be
+ * more requests left to process.
+ */
+static bool __ssh_rtl_tx_process(struct ssh_rtl *rtl)
 {
-	struct ssh_rtl *rtl = to_ssh_rtl(work, tx.work);
 	unsigned int iterations = SSH_RTL_TX_BATCH;
 	int status;
 
+	lockdep_assert_held(&rtl->tx.lock);
+
 	/*
-	 * Try to be nice and not block/live-lock the workqueue: Run a maximum
-	 * of 10 tries, then re-submit if necessary. This should not be
-	 * necessary for normal execution, but guarantee it anyway.
+	 * Try to be nice and not block/live-lock the workqueue or the
+	 * submitting context: Run a maximum of 10 tries, then re-submit if
+	 * necessary. This should not be necessary for normal execution, but
+	 * guarantee it anyway.
 	 */
 	do {
 		status = ssh_rtl_tx_try_process_one(rtl);
 		if (status == -ENOENT || status == -EBUSY)
-			return;		/* No more requests to process. */
+			return false;	/* No more requests to process. */
 
 		if (status == -ESHUTDOWN) {
 			/*
@@ -335,31 +382,67 @@ static void ssh_rtl_tx_work_fn(struct work_struct *work)
 			 * transmitted. Return silently, the party initiating
 			 * the shutdown should handle the rest.
 			 */
-			return;
+			return false;
 		}
 
 		WARN_ON(status != 0 && status != -EAGAIN);
 	} while (--iterations);
 
+	return true;
+}
+
+static void ssh_rtl_tx_work_fn(struct work_struct *work)
+{
+	struct ssh_rtl *rtl = to_ssh_rtl(work, tx.work);
+	bool more;
+
+	mutex_lock(&rtl->tx.lock);
+	more = __ssh_rtl_tx_process(rtl);
+	mutex_unlock(&rtl->tx.lock);
+
 	/* Out of tries, reschedule. */
-	ssh_rtl_tx_schedule(rtl);
+	if (more)
+		ssh_rtl_tx_schedule(rtl);
 }
 
 /**
- * ssh_rtl_submit() - Submit a request to the transport layer.
- * @rtl:  The request transport layer.
- * @rqst: The request to submit.
+ * ssh_rtl_tx_process() - Transfer requests to the packet layer directly.
+ * @rtl: The request transport layer.
  *
- * Submits a request to the transport layer. A single request may not be
- * submitted multiple times without reinitializing it.
+ * Transfers queued requests to the packet layer directly from the calling
+ * context if there is capacity for more pending requests and no one else is
+ * currently transferring requests, avoiding the detour via the transmitter
+ * work item. Otherwise, transfer is deferred to the transmitter work item.
  *
- * Return: Returns zero on success, %-EINVAL if the request type is invalid or
- * the request has been canceled prior to submission, %-EALREADY if the
- * request has already been submitted, or %-ESHUTDOWN in case the request
- * transport layer has been shut down.
+ * Must only be called from a context that is allowed to sleep, as submitting
+ * packets to the packet layer may sleep.
  */
-int ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
+static void ssh_rtl_tx_process(struct ssh_rtl *rtl)
+{
+	bool more;
+
+	might_sleep();
+
+	if (!ssh_rtl_tx_can_schedule(rtl))
+		return;
+
+	if (!mutex_trylock(&rtl->tx.lock)) {
+		ssh_rtl_tx_schedule(rtl);
+		return;
+	}
+
+	more = __ssh_rtl_tx_process(rtl);
+	mutex_unlock(&rtl->tx.lock);
+
+	if (more)
+		ssh_rtl_tx_schedule(rtl);
+}
+
+/* Must be called with queue lock held. */
+static int __ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
 {
+	lockdep_assert_held(&rtl->queue.lock);
+
 	trace_ssam_request_submit(rqst);
 
 	/*
@@ -371,8 +454,6 @@ int ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
 		if (!test_bit(SSH_PACKET_TY_SEQUENCED_BIT, &rqst->packet.state))
 			return -EINVAL;
 
-	spin_lock(&rtl->queue.lock);
-
 	/*
 	 * Try to set ptl and check if this request has already been submitted.
 	 *
@@ -388,10 +469,8 @@ int ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
 	 * push operation has been completed (via lock) due to that. Only then,
 	 * we can safely try to remove it.
 	 */
-	if (cmpxchg(&rqst->packet.ptl, NULL, &rtl->ptl)) {
-		spin_unlock(&rtl->queue.lock);
+	if (cmpxchg(&rqst->packet.ptl, NULL, &rtl->ptl))
 		return -EALREADY;
-	}
 
 	/*
 	 * Ensure that we set ptl reference before we continue modifying state.
@@ -404,46 +483,138 @@ int ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
 	 */
 	smp_mb__after_atomic();
 
-	if (test_bit(SSH_RTL_SF_SHUTDOWN_BIT, &rtl->state)) {
-		spin_unlock(&rtl->queue.lock);
+	if (test_bit(SSH_RTL_SF_SHUTDOWN_BIT, &rtl->state))
 		return -ESHUTDOWN;
-	}
 
-	if (test_bit(SSH_REQUEST_SF_LOCKED_BIT, &rqst->state)) {
-		spin_unlock(&rtl->queue.lock);
+	if (test_bit(SSH_REQUEST_SF_LOCKED_BIT, &rqst->state))
 		return -EINVAL;
-	}
+
+	rqst->submitted = ktime_get_boottime();
 
 	set_bit(SSH_REQUEST_SF_QUEUED_BIT, &rqst->state);
 	list_add_tail(&ssh_request_get(rqst)->node, &rtl->queue.head);
 
+	return 0;
+}
+
+static int ssh_rtl_queue_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
+{
+	int status;
+
+	spin_lock(&rtl->queue.lock);
+	status = __ssh_rtl_submit(rtl, rqst);
 	spin_unlock(&rtl->queue.lock);
 
+	return status;
+}
+
+/**
+ * ssh_rtl_submit() - Submit a request to the transport layer.
+ * @rtl:  The request transport layer.
+ * @rqst: The request to submit.
+ *
+ * Submits a request to the transport layer. A single request may not be
+ * submitted multiple times without reinitializing it. The request is passed
+ * on to the packet layer by the transmitter work item. May be called from
+ * any context. See ssh_rtl_submit_direct() for a variant that avoids the
+ * work item when called from a context that is allowed to sleep.
+ *
+ * Return: Returns zero on success, %-EINVAL if the request type is invalid or
+ * the request has been canceled prior to submission, %-EALREADY if the
+ * request has already been submitted, or %-ESHUTDOWN in case the request
+ * transport layer has been shut down.
+ */
+int ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst)
+{
+	int status;
+
+	status = ssh_rtl_queue_submit(rtl, rqst);
+	if (status)
+		return status;
+
 	ssh_rtl_tx_schedule(rtl);
 	return 0;
 }
 
-static void ssh_rtl_timeout_reaper_mod(struct ssh_rtl *rtl, ktime_t now,
-				       ktime_t expires)
+/**
+ * ssh_rtl_submit_direct() - Submit a request to the transport layer and pass
+ * it on directly.
+ * @rtl:  The request transport layer.
+ * @rqst: The request to submit.
+ *
+ * Submits a request to the transport layer like ssh_rtl_submit(). If there
+ * is capacity for more pending requests and the transmitter is idle, the
+ * request is passed on to the packet layer directly from the calling context
+ * instead of the transmitter work item.
+ *
+ * Must only be called from a context that is allowed to sleep. Note that the
+ * packet layer may transmit the request and, on failure, complete it before
+ * this function returns, i.e. completion callbacks may run in the calling
+ * context.
+ *
+ * Return: See ssh_rtl_submit().
+ */
+int ssh_rtl_submit_direct(struct ssh_rtl *rtl, struct ssh_request *rqst)
+{
+	int status;
+
+	might_sleep();
+
+	status = ssh_rtl_queue_submit(rtl, rqst);
+	if (status)
+		return status;
+
+	ssh_rtl_tx_process(rtl);
+	return 0;
+}
+
+/**
+ * ssh_rtl_submit_batch() - Submit multiple requests to the transport layer.
+ * @rtl:    The request transport layer.
+ * @rqsts:  The requests to submit.
+ * @status: Array receiving the submission status of each request.
+ * @n:      The number of requests to submit.
+ *
+ * Submits the given requests to the transport layer as a single unit, in
+ * order. This behaves like calling ssh_rtl_submit() for each request, but
+ * takes the queue lock and processes the queue only once, allowing the
+ * requests to be pipelined by the transport layer. Like
+ * ssh_rtl_submit_direct(), the requests are passed on to the packet layer
+ * directly if possible, so this must only be called from a context that is
+ * allowed to sleep.
+ *
+ * The submission status of each request is stored in the respective entry
+ * of @status. See ssh_rtl_submit() for possible values. A failed submission
+ * does not affect the remaining requests.
+ *
+ * Return: Returns the number of successfully submitted requests.
+ */
+unsigned int ssh_rtl_submit_batch(struct ssh_rtl *rtl,
+				  struct ssh_request **rqsts, int *status,
+				  unsigned int n)
 {
-	unsigned long delta = msecs_to_jiffies(ktime_ms_delta(expires, now));
-	ktime_t aexp = ktime_add(expires, SSH_RTL_REQUEST_TIMEOUT_RESOLUTION);
+	unsigned int i, submitted = 0;
 
-	spin_lock(&rtl->rtx_timeout.lock);
+	might_sleep();
 
-	/* Re-adjust / schedule reaper only if it is above resolution delta. */
-	if (ktime_before(aexp, rtl->rtx_timeout.expires)) {
-		rtl->rtx_timeout.expires = expires;
-		mod_delayed_work(system_wq, &rtl->rtx_timeout.reaper, delta);
+	spin_lock(&rtl->queue.lock);
+	for (i = 0; i < n; i++) {
+		status[i] = __ssh_rtl_submit(rtl, rqsts[i]);
+		if (!status[i])
+			submitted++;
 	}
+	spin_unlock(&rtl->queue.lock);
+
+	if (submitted)
+		ssh_rtl_tx_process(rtl);
 
-	spin_unlock(&rtl->rtx_timeout.lock);
+	return submitted;
 }
 
 static void ssh_rtl_timeout_start(struct ssh_request *rqst)
 {
 	struct ssh_rtl *rtl = ssh_request_rtl(rqst);
-	ktime_t timestamp = ktime_get_coarse_boottime();
+	ktime_t timestamp = ktime_get_boottime();
 	ktime_t timeout = rtl->rtx_timeout.timeout;
 
 	if (test_bit(SSH_REQUEST_SF_LOCKED_BIT, &rqst->state))
@@ -461,7 +632,7 @@ static void ssh_rtl_timeout_start(struct ssh_request *rqst)
 	 */
 	smp_mb__after_atomic();
 
-	ssh_rtl_timeout_reaper_mod(rtl, timestamp, timestamp + timeout);
+	ssh_timeout_arm(&rtl->rtx_timeout.timer, ktime_add(timestamp, timeout));
 }
 
 static void ssh_rtl_complete(struct ssh_rtl *rtl,
@@ -469,7 +640,7 @@ static void ssh_rtl_complete(struct ssh_rtl *rtl,
 			     const struct ssam_span *command_data)
 {
 	struct ssh_request *r = NULL;
-	struct ssh_request *p, *n;
+	struct ssh_request *p;
 	u16 rqid = get_unaligned_le16(&command->rqid);
 
 	trace_ssam_rx_response_received(command, command_data->len);
@@ -479,9 +650,8 @@ static void ssh_rtl_complete(struct ssh_rtl *rtl,
 	 * received and locked.
 	 */
 	spin_lock(&rtl->pending.lock);
-	list_for_each_entry_safe(p, n, &rtl->pending.head, node) {
-		/* We generally expect requests to be processed in order. */
-		if (unlikely(ssh_request_get_rqid(p) != rqid))
+	hash_for_each_possible(rtl->pending.table, p, hash_node, rqid) {
+		if (ssh_request_get_rqid_safe(p) != rqid)
 			continue;
 
 		/* Simulate response timeout. */
@@ -506,6 +676,7 @@ static void ssh_rtl_complete(struct ssh_rtl *rtl,
 
 		atomic_dec(&rtl->pending.count);
 		list_del(&p->node);
+		hash_del(&p->hash_node);
 
 		r = p;
 		break;
@@ -515,6 +686,7 @@ static void ssh_rtl_complete(struct ssh_rtl *rtl,
 	if (!r) {
 		rtl_warn(rtl, "rtl: dropping unexpected command message (rqid = %#06x)\n",
 			 rqid);
+		atomic_long_inc(&rtl->stats.unexpected);
 		return;
 	}
 
@@ -572,6 +744,10 @@ static void ssh_rtl_complete(struct ssh_rtl *rtl,
 	 * anywhere.
 	 */
 
+	ssh_latency_record(&rtl->latency, SSH_LATENCY_TX_RESPONSE,
+			   ssh_request_get_tc(r), r->transmitted,
+			   ktime_get_boottime());
+
 	ssh_rtl_complete_with_rsp(r, command, command_data);
 	ssh_request_put(r);
 
@@ -748,6 +924,34 @@ bool ssh_rtl_cancel(struct ssh_request *rqst, bool pending)
 	return canceled;
 }
 
+static void ssh_rtl_latency_record_tx(struct ssh_request *r)
+{
+	struct ssh_rtl *rtl = ssh_request_rtl(r);
+	ktime_t now = ktime_get_boottime();
+	u8 tc = ssh_request_get_tc(r);
+	ktime_t tx = now;
+
+	/*
+	 * Unsequenced packets are completed once they have been transmitted.
+	 * Sequenced packets are completed once they have been ACKed. At that
+	 * point, the packet has been removed from the pending set and locked,
+	 * so its timestamp, indicating the start of its last transmission,
+	 * cannot change any more.
+	 */
+	if (test_bit(SSH_PACKET_TY_SEQUENCED_BIT, &r->packet.state)) {
+		tx = READ_ONCE(r->packet.timestamp);
+		if (tx == KTIME_MAX)
+			tx = now;
+
+		ssh_latency_record(&rtl->latency, SSH_LATENCY_TX_ACK, tc, tx, now);
+	}
+
+	ssh_latency_record(&rtl->latency, SSH_LATENCY_SUBMIT_TX, tc,
+			   r->submitted, tx);
+
+	r->transmitted = tx;
+}
+
 static void ssh_rtl_packet_callback(struct ssh_packet *p, int status)
 {
 	struct ssh_request *r = to_ssh_request(p);
@@ -773,6 +977,8 @@ static void ssh_rtl_packet_callback(struct ssh_packet *p, int status)
 		return;
 	}
 
+	ssh_rtl_latency_record_tx(r);
+
 	/* Update state: Mark as transmitted and clear transmitting. */
 	set_bit(SSH_REQUEST_SF_TRANSMITTED_BIT, &r->state);
 	/* Ensure state never gets zero. */
@@ -819,23 +1025,15 @@ static ktime_t ssh_request_get_expiration(struct ssh_request *r, ktime_t timeout
 
 static void ssh_rtl_timeout_reap(struct work_struct *work)
 {
-	struct ssh_rtl *rtl = to_ssh_rtl(work, rtx_timeout.reaper.work);
+	struct ssh_rtl *rtl = to_ssh_rtl(work, rtx_timeout.reaper);
 	struct ssh_request *r, *n;
 	LIST_HEAD(claimed);
-	ktime_t now = ktime_get_coarse_boottime();
+	ktime_t now = ktime_get_boottime();
 	ktime_t timeout = rtl->rtx_timeout.timeout;
 	ktime_t next = KTIME_MAX;
 
 	trace_ssam_rtl_timeout_reap(atomic_read(&rtl->pending.count));
 
-	/*
-	 * Mark reaper as "not pending". This is done before checking any
-	 * requests to avoid lost-update type problems.
-	 */
-	spin_lock(&rtl->rtx_timeout.lock);
-	rtl->rtx_timeout.expires = KTIME_MAX;
-	spin_unlock(&rtl->rtx_timeout.lock);
-
 	spin_lock(&rtl->pending.lock);
 	list_for_each_entry_safe(r, n, &rtl->pending.head, node) {
 		ktime_t expires = ssh_request_get_expiration(r, timeout);
@@ -864,7 +1062,13 @@ static void ssh_rtl_timeout_reap(struct work_struct *work)
 
 		atomic_dec(&rtl->pending.count);
 		list_move_tail(&r->node, &claimed);
+		hash_del(&r->hash_node);
 	}
+
+	/* Re-arm timeout for the next request to expire. */
+	if (next != KTIME_MAX)
+		ssh_timeout_arm(&rtl->rtx_timeout.timer, next);
+
 	spin_unlock(&rtl->pending.lock);
 
 	/* Cancel and complete the request. */
@@ -876,8 +1080,10 @@ static void ssh_rtl_timeout_reap(struct work_struct *work)
 		 * means that we've obtained the last (only) reference of the
 		 * system to it. Thus we can just complete it.
 		 */
-		if (!test_and_set_bit(SSH_REQUEST_SF_COMPLETED_BIT, &r->state))
+		if (!test_and_set_bit(SSH_REQUEST_SF_COMPLETED_BIT, &r->state)) {
 			ssh_rtl_complete_with_status(r, -ETIMEDOUT);
+			atomic_long_inc(&rtl->stats.timeouts);
+		}
 
 		/*
 		 * Drop the reference we've obtained by removing it from the
@@ -887,14 +1093,19 @@ static void ssh_rtl_timeout_reap(struct work_struct *work)
 		ssh_request_put(r);
 	}
 
-	/* Ensure that the reaper doesn't run again immediately. */
-	next = max(next, ktime_add(now, SSH_RTL_REQUEST_TIMEOUT_RESOLUTION));
-	if (next != KTIME_MAX)
-		ssh_rtl_timeout_reaper_mod(rtl, now, next);
-
 	ssh_rtl_tx_schedule(rtl);
 }
 
+static void ssh_rtl_timeout_expired(struct ssh_timeout *timeout)
+{
+	struct ssh_rtl *rtl = to_ssh_rtl(timeout, rtx_timeout.timer);
+
+	if (test_bit(SSH_RTL_SF_SHUTDOWN_BIT, &rtl->state))
+		return;
+
+	schedule_work(&rtl->rtx_timeout.reaper);
+}
+
 static void ssh_rtl_rx_event(struct ssh_rtl *rtl, const struct ssh_command *cmd,
 			     const struct ssam_span *data)
 {
@@ -998,12 +1209,15 @@ int ssh_request_init(struct ssh_request *rqst, enum ssam_request_flags flags,
 			&ssh_rtl_packet_ops);
 
 	INIT_LIST_HEAD(&rqst->node);
+	INIT_HLIST_NODE(&rqst->hash_node);
 
 	rqst->state = 0;
 	if (flags & SSAM_REQUEST_HAS_RESPONSE)
 		rqst->state |= BIT(SSH_REQUEST_TY_HAS_RESPONSE_BIT);
 
 	rqst->timestamp = KTIME_MAX;
+	rqst->submitted = KTIME_MAX;
+	rqst->transmitted = KTIME_MAX;
 	rqst->ops = ops;
 
 	return 0;
@@ -1034,19 +1248,32 @@ int ssh_rtl_init(struct ssh_rtl *rtl, struct serdev_device *serdev,
 	if (status)
 		return status;
 
+	status = ssh_latency_init(&rtl->latency);
+	if (status) {
+		ssh_ptl_destroy(&rtl->ptl);
+		return status;
+	}
+
 	spin_lock_init(&rtl->queue.lock);
 	INIT_LIST_HEAD(&rtl->queue.head);
 
 	spin_lock_init(&rtl->pending.lock);
 	INIT_LIST_HEAD(&rtl->pending.head);
 	atomic_set_release(&rtl->pending.count, 0);
+	rtl->pending.max = clamp_t(unsigned int, max_pending_requests, 1,
+				   SSH_RTL_MAX_WINDOW);
+	hash_init(rtl->pending.table);
 
+	mutex_init(&rtl->tx.lock);
 	INIT_WORK(&rtl->tx.work, ssh_rtl_tx_work_fn);
 
-	spin_lock_init(&rtl->rtx_timeout.lock);
 	rtl->rtx_timeout.timeout = SSH_RTL_REQUEST_TIMEOUT;
-	rtl->rtx_timeout.expires = KTIME_MAX;
-	INIT_DELAYED_WORK(&rtl->rtx_timeout.reaper, ssh_rtl_timeout_reap);
+	ssh_timeout_init(&rtl->rtx_timeout.timer, SSH_RTL_REQUEST_TIMEOUT_RESOLUTION,
+			 ssh_rtl_timeout_expired);
+	INIT_WORK(&rtl->rtx_timeout.reaper, ssh_rtl_timeout_reap);
+
+	atomic_long_set(&rtl->stats.unexpected, 0);
+	atomic_long_set(&rtl->stats.timeouts, 0);
 
 	rtl->ops = *ops;
 
@@ -1064,6 +1291,8 @@ int ssh_rtl_init(struct ssh_rtl *rtl, struct serdev_device *serdev,
  */
 void ssh_rtl_destroy(struct ssh_rtl *rtl)
 {
+	mutex_destroy(&rtl->tx.lock);
+	ssh_latency_destroy(&rtl->latency);
 	ssh_ptl_destroy(&rtl->ptl);
 }
 
@@ -1164,7 +1393,7 @@ int ssh_rtl_flush(struct ssh_rtl *rtl, unsigned long timeout)
 
 	init_completion(&rqst.completion);
 
-	status = ssh_rtl_submit(rtl, &rqst.base);
+	status = ssh_rtl_submit_direct(rtl, &rqst.base);
 	if (status)
 		return status;
 
@@ -1224,16 +1453,26 @@ void ssh_rtl_shutdown(struct ssh_rtl *rtl)
 	/*
 	 * We have now guaranteed that the queue is empty and no more new
 	 * requests can be submitted (i.e. it will stay empty). This means that
-	 * calling ssh_rtl_tx_schedule() will not schedule tx.work any more. So
-	 * we can simply call cancel_work_sync() on tx.work here and when that
-	 * returns, we've locked it down. This also means that after this call,
-	 * we don't submit any more packets to the underlying packet layer, so
-	 * we can also shut that down.
+	 * calling ssh_rtl_tx_schedule() will not schedule tx.work any more and
+	 * ssh_rtl_tx_process() will not find any requests to transfer. So we
+	 * can simply call cancel_work_sync() on tx.work here and wait for any
+	 * direct transfer still in progress by taking the transmitter lock.
+	 * After that, we don't submit any more packets to the underlying
+	 * packet layer, so we can also shut that down.
 	 */
 
 	cancel_work_sync(&rtl->tx.work);
+	mutex_lock(&rtl->tx.lock);
+	mutex_unlock(&rtl->tx.lock);
 	ssh_ptl_shutdown(&rtl->ptl);
-	cancel_delayed_work_sync(&rtl->rtx_timeout.reaper);
+
+	/*
+	 * The reaper may re-arm the timeout, so cancel the timeout only after
+	 * the reaper has finished. Due to the shutdown bit, the timeout will
+	 * not schedule the reaper again.
+	 */
+	cancel_work_sync(&rtl->rtx_timeout.reaper);
+	ssh_timeout_cancel_sync(&rtl->rtx_timeout.timer);
 
 	/*
 	 * Shutting down the packet layer should also have canceled all
@@ -1251,6 +1490,7 @@ void ssh_rtl_shutdown(struct ssh_rtl *rtl)
 			clear_bit(SSH_REQUEST_SF_PENDING_BIT, &r->state);
 
 			list_move_tail(&r->node, &claimed);
+			hash_del(&r->hash_node);
 		}
 		spin_unlock(&rtl->pending.lock);
 	}
@@ -9,15 +9,27 @@
 #define _SURFACE_AGGREGATOR_SSH_REQUEST_LAYER_H
 
 #include <linux/atomic.h>
+#include <linux/hashtable.h>
 #include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
 
 #include "../include/linux/surface_aggregator/serial_hub.h"
 #include "../include/linux/surface_aggregator/controller.h"
 
+#include "ssh_latency.h"
 #include "ssh_packet_layer.h"
+#include "ssh_timeout.h"
+
+/*
+ * SSH_RTL_PENDING_HASH_BITS - Size of the pending-request lookup table.
+ *
+ * Number of bits of the request ID used to index the table for looking up
+ * pending requests when a response is received.
+ */
+#define SSH_RTL_PENDING_HASH_BITS	5
 
 /**
  * enum ssh_rtl_state_flags - State-flags for &struct ssh_rtl.
@@ -53,13 +65,23 @@ struct ssh_rtl_ops {
  * @pending.lock:  Lock for modifying the request set.
  * @pending.head:  List-head of the pending set/list.
  * @pending.count: Number of currently pending requests.
+ * @pending.max:   Maximum number of pending requests.
+ * @pending.table: Pending requests, hashed by request ID.
  * @tx:            Transmitter subsystem.
- * @tx.work:       Transmitter work item.
+ * @tx.lock:       Lock serializing the transfer of requests to the packet
+ *                 layer.
+ * @tx.work:       Transmitter work item, for requests that could not be
+ *                 transferred directly from the submitting context.
  * @rtx_timeout:   Retransmission timeout subsystem.
- * @rtx_timeout.lock:    Lock for modifying the retransmission timeout reaper.
  * @rtx_timeout.timeout: Timeout interval for retransmission.
- * @rtx_timeout.expires: Time specifying when the reaper work is next scheduled.
+ * @rtx_timeout.timer:   Timeout engine, scheduling the reaper when pending
+ *                       requests need to be checked for expiration.
  * @rtx_timeout.reaper:  Work performing timeout checks and subsequent actions.
+ * @latency:       Latency statistics of requests and events.
+ * @stats:         Request statistics.
+ * @stats.unexpected: Number of responses dropped because no matching pending
+ *                 request could be found.
+ * @stats.timeouts: Number of requests canceled due to a response timeout.
  * @ops:           Request layer operations.
  */
 struct ssh_rtl {
@@ -75,19 +97,28 @@ struct ssh_rtl {
 		spinlock_t lock;
 		struct list_head head;
 		atomic_t count;
+		int max;
+		DECLARE_HASHTABLE(table, SSH_RTL_PENDING_HASH_BITS);
 	} pending;
 
 	struct {
+		struct mutex lock;
 		struct work_struct work;
 	} tx;
 
 	struct {
-		spinlock_t lock;
 		ktime_t timeout;
-		ktime_t expires;
-		struct delayed_work reaper;
+		struct ssh_timeout timer;
+		struct work_struct reaper;
 	} rtx_timeout;
 
+	struct ssh_latency latency;
+
+	struct {
+		atomic_long_t unexpected;
+		atomic_long_t timeouts;
+	} stats;
+
 	struct ssh_rtl_ops ops;
 };
 
@@ -127,6 +158,10 @@ static inline struct ssh_rtl *ssh_request_rtl(struct ssh_request *rqst)
 }
 
 int ssh_rtl_submit(struct ssh_rtl *rtl, struct ssh_request *rqst);
+int ssh_rtl_submit_direct(struct ssh_rtl *rtl, struct ssh_request *rqst);
+unsigned int ssh_rtl_submit_batch(struct ssh_rtl *rtl,
+				  struct ssh_request **rqsts, int *status,
+				  unsigned int n);
 bool ssh_rtl_cancel(struct ssh_request *rqst, bool pending);
 
 int ssh_rtl_init(struct ssh_rtl *rtl, struct serdev_device *serdev,
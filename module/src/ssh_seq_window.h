@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SSH sequence ID window for retransmission detection.
+ *
+ * Copyright (C) 2019-2022 Maximilian Luz <luzmaximilian@gmail.com>
+ */
+
+#ifndef _SURFACE_AGGREGATOR_SSH_SEQ_WINDOW_H
+#define _SURFACE_AGGREGATOR_SSH_SEQ_WINDOW_H
+
+#include <linux/bitmap.h>
+#include <linux/bitops.h>
+#include <linux/limits.h>
+#include <linux/minmax.h>
+#include <linux/types.h>
+
+/*
+ * SSH_SEQ_WINDOW_MAX - Upper limit for the sequence ID window size.
+ *
+ * Must be smaller than half the number of sequence IDs, so that the IDs
+ * following the most recently received one are always released and that
+ * IDs inside the window can be told apart from IDs ahead of it.
+ */
+#define SSH_SEQ_WINDOW_MAX	127
+
+/**
+ * struct ssh_seq_window - Window of recently received sequence IDs.
+ * @blocked: Bitmap of recent/blocked sequence IDs, indexed by sequence ID.
+ * @size:    Number of sequence IDs, up to and including the newest received
+ *           one, that are kept blocked.
+ * @last:    The newest received sequence ID, i.e. the end of the window, or
+ *           -1 if no sequence ID has been received yet.
+ */
+struct ssh_seq_window {
+	DECLARE_BITMAP(blocked, U8_MAX + 1);
+	unsigned int size;
+	int last;
+};
+
+/**
+ * ssh_seq_window_init() - Initialize sequence ID window.
+ * @w:    The window to initialize.
+ * @size: The window size, between 1 and %SSH_SEQ_WINDOW_MAX.
+ *
+ * Initializes the given window with no sequence IDs blocked.
+ */
+static inline void ssh_seq_window_init(struct ssh_seq_window *w,
+				       unsigned int size)
+{
+	bitmap_zero(w->blocked, U8_MAX + 1);
+	w->size = size;
+	w->last = -1;
+}
+
+/**
+ * ssh_seq_window_test() - Check if a sequence ID is blocked.
+ * @w:   The window.
+ * @seq: The sequence ID to check.
+ *
+ * Return: Returns %true if the given sequence ID has been received recently,
+ * i.e. lies inside the window, %false otherwise.
+ */
+static inline bool ssh_seq_window_test(const struct ssh_seq_window *w, u8 seq)
+{
+	return test_bit(seq, w->blocked);
+}
+
+/**
+ * ssh_seq_window_block() - Block a sequence ID.
+ * @w:   The window.
+ * @seq: The sequence ID of the received data packet.
+ *
+ * Marks the given sequence ID as recently received. If it lies ahead of the
+ * window, slides the window so that it ends at this sequence ID, i.e.
+ * releases all sequence IDs outside of the @w->size IDs up to and including
+ * the given one. This also handles wrap-around from 0xff to 0x00.
+ *
+ * Sequence IDs received out of order, e.g. re-transmissions of packets lost
+ * earlier, do not move the window back. They are only blocked if they lie
+ * inside the window.
+ */
+static inline void ssh_seq_window_block(struct ssh_seq_window *w, u8 seq)
+{
+	const unsigned int nbits = U8_MAX + 1;
+	const unsigned int len = nbits - w->size;
+	const unsigned int start = (seq + 1) % nbits;
+	const unsigned int head = min(len, nbits - start);
+
+	/* Sequence ID lies behind the end of the window. */
+	if (w->last >= 0 && (u8)(seq - w->last) > SSH_SEQ_WINDOW_MAX) {
+		if ((u8)(w->last - seq) < w->size)
+			__set_bit(seq, w->blocked);
+		return;
+	}
+
+	__set_bit(seq, w->blocked);
+	w->last = seq;
+
+	/* Release the sequence IDs following this one, wrapping around. */
+	bitmap_clear(w->blocked, start, head);
+	bitmap_clear(w->blocked, 0, len - head);
+}
+
+#endif /* _SURFACE_AGGREGATOR_SSH_SEQ_WINDOW_H */
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SSH timeout engine for pending packets and requests.
+ *
+ * Copyright (C) 2019-2022 Maximilian Luz <luzmaximilian@gmail.com>
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+#include "ssh_timeout.h"
+
+static enum hrtimer_restart ssh_timeout_timer_fn(struct hrtimer *timer)
+{
+	struct ssh_timeout *t = to_ssh_timeout(timer, timer);
+	unsigned long flags;
+
+	/*
+	 * Mark timeout as "not armed" before notifying the owner. The owner
+	 * will re-arm it for any items that have not yet expired.
+	 */
+	spin_lock_irqsave(&t->lock, flags);
+	t->expires = KTIME_MAX;
+	spin_unlock_irqrestore(&t->lock, flags);
+
+	t->fn(t);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * ssh_timeout_init() - Initialize timeout.
+ * @t:     The timeout to initialize.
+ * @slack: The allowed slack of the timeout.
+ * @fn:    The callback invoked on expiration.
+ */
+void ssh_timeout_init(struct ssh_timeout *t, ktime_t slack, ssh_timeout_fn fn)
+{
+	spin_lock_init(&t->lock);
+	t->expires = KTIME_MAX;
+	t->slack = ktime_to_ns(slack);
+	t->fn = fn;
+
+	hrtimer_init(&t->timer, CLOCK_BOOTTIME, HRTIMER_MODE_ABS);
+	t->timer.function = ssh_timeout_timer_fn;
+}
+
+/**
+ * ssh_timeout_arm() - Arm timeout for the given expiration date.
+ * @t:       The timeout.
+ * @expires: The expiration date of the item to arm the timeout for.
+ *
+ * Arms the timeout for the given expiration date if it is currently not
+ * armed or armed for a later date. Does nothing if the timeout is already
+ * armed to expire earlier or within the allowed slack after the given date.
+ */
+void ssh_timeout_arm(struct ssh_timeout *t, ktime_t expires)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+
+	/* Re-adjust timer only if it would fire notably later. */
+	if (ktime_before(ktime_add_ns(expires, t->slack), t->expires)) {
+		t->expires = expires;
+		hrtimer_start_range_ns(&t->timer, expires, t->slack,
+				       HRTIMER_MODE_ABS);
+	}
+
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+/**
+ * ssh_timeout_disarm() - Disarm timeout.
+ * @t: The timeout.
+ *
+ * Disarms the timeout, e.g. because there are no more items with active
+ * timeout. This is done on a best-effort basis: If the timer callback is
+ * already running, the owner will still be notified. Use
+ * ssh_timeout_cancel_sync() to ensure that the callback has finished.
+ */
+void ssh_timeout_disarm(struct ssh_timeout *t)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&t->lock, flags);
+	t->expires = KTIME_MAX;
+	hrtimer_try_to_cancel(&t->timer);
+	spin_unlock_irqrestore(&t->lock, flags);
+}
+
+/**
+ * ssh_timeout_cancel_sync() - Cancel timeout and wait for callback to finish.
+ * @t: The timeout.
+ *
+ * Must not be called while the owner may still arm the timeout.
+ */
+void ssh_timeout_cancel_sync(struct ssh_timeout *t)
+{
+	hrtimer_cancel(&t->timer);
+	t->expires = KTIME_MAX;
+}
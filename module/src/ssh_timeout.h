@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * SSH timeout engine for pending packets and requests.
+ *
+ * Copyright (C) 2019-2022 Maximilian Luz <luzmaximilian@gmail.com>
+ */
+
+#ifndef _SURFACE_AGGREGATOR_SSH_TIMEOUT_H
+#define _SURFACE_AGGREGATOR_SSH_TIMEOUT_H
+
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+struct ssh_timeout;
+
+/**
+ * typedef ssh_timeout_fn - Callback for timeout expiration.
+ * @timeout: The expired timeout.
+ *
+ * Called in hard-IRQ context once the timeout expires. The callback must not
+ * handle the expired items directly, but instead defer this handling to the
+ * process context of its owner, e.g. by waking up a thread or scheduling a
+ * work item. The owner is then responsible for re-arming the timeout for any
+ * items that have not yet expired.
+ */
+typedef void (*ssh_timeout_fn)(struct ssh_timeout *timeout);
+
+/**
+ * struct ssh_timeout - High-resolution timeout for pending items.
+ * @lock:    Lock guarding the expiration date.
+ * @expires: Time at which the timer is currently set to expire. %KTIME_MAX if
+ *           the timer is not armed.
+ * @slack:   Allowed slack of the timer. Expirations closer together than this
+ *           may be combined.
+ * @timer:   The underlying high-resolution timer.
+ * @fn:      Callback invoked on expiration.
+ *
+ * Timeout shared by a set of pending items. The owner keeps track of the
+ * expiration dates of individual items and arms the timeout with the earliest
+ * one, which then notifies the owner via the provided callback. Timestamps
+ * must be taken from ktime_get_boottime().
+ */
+struct ssh_timeout {
+	spinlock_t lock;
+	ktime_t expires;
+	u64 slack;
+	struct hrtimer timer;
+	ssh_timeout_fn fn;
+};
+
+#define to_ssh_timeout(ptr, member) \
+	container_of(ptr, struct ssh_timeout, member)
+
+void ssh_timeout_init(struct ssh_timeout *t, ktime_t slack, ssh_timeout_fn fn);
+void ssh_timeout_arm(struct ssh_timeout *t, ktime_t expires);
+void ssh_timeout_disarm(struct ssh_timeout *t);
+void ssh_timeout_cancel_sync(struct ssh_timeout *t);
+
+#endif /* _SURFACE_AGGREGATOR_SSH_TIMEOUT_H */
@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for sliding-window transmission with non-cumulative ACKs.
+ *
+ * Models the packet layer transmitting sequenced packets to a receiver over
+ * an in-order link, with a number of packets in flight and data packets or
+ * ACKs that may get lost, mirroring the ssh_ptl_should_drop_dsq_packet() and
+ * ssh_ptl_should_drop_ack_packet() fault injection. The sender acknowledges
+ * packets like ssh_ptl_ack_pop() does, the receiver detects retransmissions
+ * via the sequence ID window used by ssh_ptl_rx_retransmit_check().
+ */
+
+#include "test.h"
+#include "util.h"
+
+#include "../module/src/ssh_seq_window.h"
+
+/* See SSH_PTL_MAX_WINDOW. */
+#define MAX_WINDOW		16
+
+#define NUM_PACKETS		2000
+#define TIMEOUT			8
+#define MAX_STEPS		(NUM_PACKETS * 100)
+
+struct tx_packet {
+	unsigned int id;
+	u8 seq;
+	unsigned int sent;
+	bool pending;
+};
+
+struct link {
+	/* Sender state. */
+	struct tx_packet packets[NUM_PACKETS];
+	struct tx_packet *table[U8_MAX + 1];
+	struct tx_packet *pending[MAX_WINDOW];
+	unsigned int npending;
+	unsigned int window;
+	unsigned int next;
+	unsigned int completed;
+	unsigned int retransmitted;
+
+	/* Receiver state. */
+	struct ssh_seq_window blocked;
+	unsigned int delivered[NUM_PACKETS];
+	unsigned int ndelivered;
+	bool received[NUM_PACKETS];
+
+	/* ACKs in flight from receiver to sender. */
+	u8 acks[2 * MAX_WINDOW];
+	unsigned int nacks;
+
+	/* Link errors. */
+	bool lose[NUM_PACKETS];
+	unsigned int data_loss;
+	unsigned int ack_loss;
+	u64 seed;
+};
+
+static bool lost(struct link *l, unsigned int loss_percent)
+{
+	return rand_next(&l->seed) % 100 < loss_percent;
+}
+
+static void rx_data(struct link *l, const struct tx_packet *p)
+{
+	if (l->lose[p->id]) {
+		l->lose[p->id] = false;
+		return;
+	}
+
+	if (lost(l, l->data_loss))
+		return;
+
+	/* ACK all sequenced packets, including retransmissions. */
+	l->acks[l->nacks++] = p->seq;
+
+	if (ssh_seq_window_test(&l->blocked, p->seq))
+		return;
+
+	ssh_seq_window_block(&l->blocked, p->seq);
+
+	if (l->ndelivered < ARRAY_SIZE(l->delivered))
+		l->delivered[l->ndelivered] = p->id;
+
+	l->received[p->id] = true;
+	l->ndelivered++;
+}
+
+static void tx_complete(struct link *l, unsigned int i)
+{
+	struct tx_packet *p = l->pending[i];
+
+	/* A packet must only be completed after it has been received. */
+	EXPECT(l->received[p->id]);
+
+	p->pending = false;
+	l->table[p->seq] = NULL;
+	l->completed++;
+
+	memmove(&l->pending[i], &l->pending[i + 1],
+		(l->npending - i - 1) * sizeof(l->pending[0]));
+	l->npending--;
+}
+
+static void tx_ack(struct link *l, u8 seq)
+{
+	struct tx_packet *packet = l->table[seq];
+	unsigned int i = 0;
+
+	/* Stale ACK for a packet that has already been acknowledged. */
+	if (!packet)
+		return;
+
+	/* ACKs are not cumulative, leave earlier packets pending. */
+	while (l->pending[i] != packet)
+		i++;
+
+	tx_complete(l, i);
+}
+
+static void tx_step(struct link *l, unsigned int now)
+{
+	struct tx_packet *p;
+	unsigned int i;
+
+	/* Re-transmit timed-out packets. */
+	for (i = 0; i < l->npending; i++) {
+		p = l->pending[i];
+
+		if (now - p->sent >= TIMEOUT) {
+			p->sent = now;
+			l->retransmitted++;
+			rx_data(l, p);
+		}
+	}
+
+	/*
+	 * Transmit new packets while the window is not full, keeping the
+	 * sequence IDs in flight inside the window like
+	 * ssh_ptl_tx_can_process() does.
+	 */
+	while (l->next < NUM_PACKETS && l->npending < l->window) {
+		if (l->npending && (u8)(l->next - l->pending[0]->seq) >= l->window)
+			break;
+
+		p = &l->packets[l->next];
+		p->id = l->next;
+		p->seq = l->next;
+		p->sent = now;
+		p->pending = true;
+		l->next++;
+
+		/* The sequence ID must not be in use by another pending packet. */
+		EXPECT(!l->table[p->seq]);
+
+		l->table[p->seq] = p;
+		l->pending[l->npending++] = p;
+		rx_data(l, p);
+	}
+}
+
+static void init_link(struct link *l, unsigned int window,
+		      unsigned int rx_window, u64 seed)
+{
+	memset(l, 0, sizeof(*l));
+	l->window = window;
+	l->seed = seed;
+	ssh_seq_window_init(&l->blocked, rx_window);
+}
+
+static void step_link(struct link *l, unsigned int now)
+{
+	u8 acks[ARRAY_SIZE(l->acks)];
+	unsigned int i, n;
+
+	tx_step(l, now);
+
+	/* Deliver ACKs sent during this step, dropping some of them. */
+	n = l->nacks;
+	memcpy(acks, l->acks, n);
+	l->nacks = 0;
+
+	for (i = 0; i < n; i++) {
+		if (lost(l, l->ack_loss))
+			continue;
+
+		tx_ack(l, acks[i]);
+	}
+}
+
+static void run_link(struct link *l, unsigned int start)
+{
+	unsigned int step;
+
+	for (step = start; step < MAX_STEPS && l->completed < NUM_PACKETS; step++)
+		step_link(l, step);
+}
+
+static struct link link;
+
+static void check_link(unsigned int window, unsigned int data_loss,
+		       unsigned int ack_loss)
+{
+	unsigned int i;
+
+	init_link(&link, window, max(window, 8u), window);
+	link.data_loss = data_loss;
+	link.ack_loss = ack_loss;
+	run_link(&link, 0);
+
+	/* Every packet has been delivered exactly once. */
+	EXPECT_EQ(link.completed, NUM_PACKETS);
+	EXPECT_EQ(link.ndelivered, NUM_PACKETS);
+
+	for (i = 0; i < NUM_PACKETS; i++) {
+		if (!link.received[i]) {
+			EXPECT(link.received[i]);
+			break;
+		}
+	}
+
+	/* Without lost data packets, the link preserves the order. */
+	if (data_loss)
+		return;
+
+	for (i = 0; i < min(link.ndelivered, NUM_PACKETS); i++) {
+		if (link.delivered[i] != i) {
+			EXPECT_EQ(link.delivered[i], i);
+			break;
+		}
+	}
+}
+
+static void test_window_no_loss(void)
+{
+	unsigned int window;
+
+	for (window = 1; window <= MAX_WINDOW; window++)
+		check_link(window, 0, 0);
+}
+
+static void test_window_ack_loss(void)
+{
+	unsigned int window;
+
+	for (window = 1; window <= MAX_WINDOW; window++) {
+		check_link(window, 0, 10);
+		check_link(window, 0, 50);
+		check_link(window, 0, 90);
+	}
+}
+
+static void test_window_data_loss(void)
+{
+	unsigned int window;
+
+	for (window = 1; window <= MAX_WINDOW; window++) {
+		check_link(window, 10, 0);
+		check_link(window, 50, 0);
+		check_link(window, 10, 10);
+		check_link(window, 50, 50);
+	}
+}
+
+static void test_window_data_lost_later_acked(void)
+{
+	/*
+	 * Lose the first transmission of the first packet only. The packets
+	 * after it are received and ACKed, which must not complete the lost
+	 * one: It has to stay pending until it is re-transmitted and ACKed.
+	 */
+	init_link(&link, 4, 8, 1);
+	link.lose[0] = true;
+	step_link(&link, 0);
+
+	EXPECT_EQ(link.completed, 3);
+	EXPECT_EQ(link.packets[0].pending, true);
+	EXPECT_EQ(link.received[0], false);
+	EXPECT_EQ(link.retransmitted, 0);
+
+	run_link(&link, 1);
+
+	EXPECT_EQ(link.completed, NUM_PACKETS);
+	EXPECT_EQ(link.ndelivered, NUM_PACKETS);
+	EXPECT_EQ(link.retransmitted, 1);
+	EXPECT_EQ(link.received[0], true);
+}
+
+static void test_window_rx_too_small(void)
+{
+	/*
+	 * Re-transmissions can only be detected if the receiver remembers at
+	 * least as many sequence IDs as there can be packets in flight.
+	 */
+	init_link(&link, MAX_WINDOW, MAX_WINDOW - 1, 1);
+	link.ack_loss = 90;
+	run_link(&link, 0);
+	EXPECT(link.ndelivered > NUM_PACKETS);
+}
+
+TEST_SUITE(ack_window, NULL,
+	TEST_CASE(test_window_no_loss),
+	TEST_CASE(test_window_ack_loss),
+	TEST_CASE(test_window_data_loss),
+	TEST_CASE(test_window_data_lost_later_acked),
+	TEST_CASE(test_window_rx_too_small),
+)
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal benchmark framework.
+ *
+ * Benchmarks register themselves on startup via BENCH_SUITE() and measure
+ * individual operations via bench_run(), which repeats the operation for a
+ * fixed amount of time and reports the average time per operation and, if
+ * applicable, the throughput.
+ */
+
+#ifndef _SSAM_TESTS_BENCH_H
+#define _SSAM_TESTS_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct bench_suite {
+	const char *name;
+	void (*run)(void);
+	struct bench_suite *next;
+};
+
+/* Sink for benchmark results, prevents the compiler from eliding work. */
+extern volatile uint64_t bench_sink;
+
+void bench_suite_register(struct bench_suite *suite);
+
+uint64_t bench_now_ns(void);
+uint64_t bench_duration_ns(void);
+
+void bench_run(const char *name, size_t bytes, void (*fn)(void *ctx), void *ctx);
+void bench_report(const char *name, uint64_t ops, size_t bytes, uint64_t ns);
+
+#define BENCH_SUITE(sname, fn)						\
+	static struct bench_suite __##sname##_bench = {			\
+		.name = #sname,						\
+		.run = fn,						\
+	};								\
+	static void __attribute__((constructor)) __##sname##_register(void) \
+	{								\
+		bench_suite_register(&__##sname##_bench);		\
+	}
+
+#endif /* _SSAM_TESTS_BENCH_H */
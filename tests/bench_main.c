@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmark runner. Runs all registered benchmarks, or only those given on
+ * the command line. The time spent per measurement can be set via the
+ * BENCH_TIME_MS environment variable.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define BENCH_DEFAULT_TIME_MS	250
+
+volatile uint64_t bench_sink;
+
+static struct bench_suite *suites;
+static uint64_t duration_ns;
+
+void bench_suite_register(struct bench_suite *suite)
+{
+	struct bench_suite **p = &suites;
+
+	/* Keep suites sorted by name for deterministic output. */
+	while (*p && strcmp((*p)->name, suite->name) < 0)
+		p = &(*p)->next;
+
+	suite->next = *p;
+	*p = suite;
+}
+
+uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t bench_duration_ns(void)
+{
+	return duration_ns;
+}
+
+void bench_report(const char *name, uint64_t ops, size_t bytes, uint64_t ns)
+{
+	double ns_per_op = (double)ns / ops;
+
+	if (bytes)
+		printf("  %-40s %12.1f ns/op %10.1f MB/s\n", name, ns_per_op,
+		       (double)bytes * ops * 1000.0 / ns);
+	else
+		printf("  %-40s %12.1f ns/op\n", name, ns_per_op);
+}
+
+void bench_run(const char *name, size_t bytes, void (*fn)(void *ctx), void *ctx)
+{
+	uint64_t ops = 0, batch = 1;
+	uint64_t start, now, i;
+
+	/* Warm up caches and branch predictors. */
+	fn(ctx);
+
+	start = bench_now_ns();
+	do {
+		for (i = 0; i < batch; i++)
+			fn(ctx);
+
+		ops += batch;
+		if (batch < (1u << 16))
+			batch *= 2;
+
+		now = bench_now_ns();
+	} while (now - start < duration_ns);
+
+	bench_report(name, ops, bytes, now - start);
+}
+
+static bool selected(const struct bench_suite *suite, int argc, char **argv)
+{
+	int i;
+
+	if (argc < 2)
+		return true;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], suite->name))
+			return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	const struct bench_suite *suite;
+	const char *env;
+
+	env = getenv("BENCH_TIME_MS");
+	duration_ns = (env ? strtoull(env, NULL, 10) : BENCH_DEFAULT_TIME_MS) * 1000000ull;
+
+	for (suite = suites; suite; suite = suite->next) {
+		if (!selected(suite, argc, argv))
+			continue;
+
+		printf("%s:\n", suite->name);
+		suite->run();
+	}
+
+	return 0;
+}
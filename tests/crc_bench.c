@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for the SSH message CRC computation, compared against a
+ * bytewise table-driven implementation as used by crc_ccitt_false().
+ */
+
+#include "bench.h"
+#include "util.h"
+
+#include "../module/src/ssh_crc.h"
+
+struct crc_ctx {
+	const u8 *buf;
+	size_t len;
+};
+
+static u16 bytewise_table[256];
+static u8 buf[SSH_COMMAND_MAX_PAYLOAD_SIZE];
+
+static u16 crc_bytewise(u16 crc, const u8 *p, size_t len)
+{
+	while (len--)
+		crc = (crc << 8) ^ bytewise_table[(crc >> 8) ^ *p++];
+
+	return crc;
+}
+
+static void bench_crc_bytewise(void *ctx)
+{
+	struct crc_ctx *c = ctx;
+
+	bench_sink += crc_bytewise(0xffff, c->buf, c->len);
+}
+
+static void bench_crc_slice8(void *ctx)
+{
+	struct crc_ctx *c = ctx;
+
+	bench_sink += ssh_crc_compute(c->buf, c->len);
+}
+
+static void crc_bench(void)
+{
+	static const size_t sizes[] = { 8, 16, 64, 256, SSH_COMMAND_MAX_PAYLOAD_SIZE };
+	struct crc_ctx ctx = { .buf = buf };
+	char name[64];
+	u64 seed = 1;
+	size_t i;
+
+	ssh_crc_init();
+	rand_fill(&seed, buf, sizeof(buf));
+
+	for (i = 0; i < 256; i++) {
+		u8 b = i;
+
+		bytewise_table[i] = crc_ccitt_false(0, &b, 1);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		ctx.len = sizes[i];
+
+		snprintf(name, sizeof(name), "bytewise/len=%zu", sizes[i]);
+		bench_run(name, ctx.len, bench_crc_bytewise, &ctx);
+
+		snprintf(name, sizeof(name), "slice-by-8/len=%zu", sizes[i]);
+		bench_run(name, ctx.len, bench_crc_slice8, &ctx);
+	}
+}
+
+BENCH_SUITE(crc, crc_bench)
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SSH message CRC computation.
+ */
+
+#include "test.h"
+#include "util.h"
+
+#include "../module/src/ssh_crc.h"
+
+static u8 buf[SSH_COMMAND_MAX_PAYLOAD_SIZE + 8];
+
+static void crc_init(void)
+{
+	u64 seed = 1;
+
+	ssh_crc_init();
+	rand_fill(&seed, buf, sizeof(buf));
+}
+
+static void test_crc_check_value(void)
+{
+	/* Check value of CRC-16/CCITT-FALSE. */
+	EXPECT_EQ(ssh_crc_compute((const u8 *)"123456789", 9), 0x29b1);
+	EXPECT_EQ(ssh_crc_compute(buf, 0), 0xffff);
+}
+
+static void test_crc_lengths(void)
+{
+	size_t len, off;
+
+	/* All lengths around the slice size, at all alignments. */
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len <= 64; len++) {
+			u16 ref = crc_ccitt_false(0xffff, buf + off, len);
+
+			EXPECT_EQ(ssh_crc_compute(buf + off, len), ref);
+		}
+	}
+}
+
+static void test_crc_frame_sizes(void)
+{
+	static const size_t sizes[] = {
+		sizeof(struct ssh_frame),
+		sizeof(struct ssh_command),
+		SSH_MSG_LEN_CTRL,
+		256,
+		SSH_COMMAND_MAX_PAYLOAD_SIZE,
+	};
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		EXPECT_EQ(ssh_crc_compute(buf, sizes[i]),
+			  crc_ccitt_false(0xffff, buf, sizes[i]));
+}
+
+static void test_crc_update_chunked(void)
+{
+	const size_t len = SSH_COMMAND_MAX_PAYLOAD_SIZE;
+	const u16 ref = ssh_crc_compute(buf, len);
+	size_t chunk, pos;
+	u16 crc;
+
+	/* Computing the CRC in chunks must yield the same result. */
+	for (chunk = 1; chunk <= 19; chunk++) {
+		crc = 0xffff;
+
+		for (pos = 0; pos < len; pos += chunk)
+			crc = ssh_crc_update(crc, buf + pos, min(chunk, len - pos));
+
+		EXPECT_EQ(crc, ref);
+	}
+}
+
+static void test_crc_detects_errors(void)
+{
+	const size_t len = 64;
+	const u16 ref = ssh_crc_compute(buf, len);
+	size_t bit;
+
+	/* CRC-CCITT detects all single-bit errors. */
+	for (bit = 0; bit < len * 8; bit++) {
+		buf[bit / 8] ^= BIT(bit % 8);
+		EXPECT(ssh_crc_compute(buf, len) != ref);
+		buf[bit / 8] ^= BIT(bit % 8);
+	}
+}
+
+TEST_SUITE(crc, crc_init,
+	TEST_CASE(test_crc_check_value),
+	TEST_CASE(test_crc_lengths),
+	TEST_CASE(test_crc_frame_sizes),
+	TEST_CASE(test_crc_update_chunked),
+	TEST_CASE(test_crc_detects_errors),
+)
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Common definitions for fuzz targets. Fuzz targets implement the libFuzzer
+ * entry point and can either be linked against libFuzzer or against the
+ * standalone driver in fuzz_main.c.
+ */
+
+#ifndef _SSAM_TESTS_FUZZ_H
+#define _SSAM_TESTS_FUZZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#define FUZZ_ASSERT(cond)						\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: assertion failed: %s\n", \
+				__FILE__, __LINE__, #cond);		\
+			abort();					\
+		}							\
+	} while (0)
+
+#endif /* _SSAM_TESTS_FUZZ_H */
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Standalone driver for fuzz targets, for use without libFuzzer.
+ *
+ * Usage: fuzz_<target> [-runs=N] [-seed=N] [FILE...]
+ *
+ * If files are given, runs the fuzz target once on each of them, e.g. to
+ * reproduce a crash found by libFuzzer. Otherwise, runs the fuzz target on N
+ * pseudo-random inputs. Inputs are generated by splicing valid messages,
+ * random data, and SYN bytes, and by randomly corrupting the result, so that
+ * all parser paths are exercised without coverage guidance.
+ */
+
+#include <string.h>
+
+#include "fuzz.h"
+#include "util.h"
+
+#define FUZZ_MAX_INPUT_LEN	(3 * RX_MAX_MSG_LEN)
+
+static u8 input[FUZZ_MAX_INPUT_LEN];
+
+static int run_file(const char *path)
+{
+	size_t len;
+	FILE *f;
+	u8 *buf;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+
+	len = fread(input, 1, sizeof(input), f);
+	fclose(f);
+
+	/* Use an exact-size copy so that sanitizers detect out-of-bounds reads. */
+	buf = malloc(len ?: 1);
+	memcpy(buf, input, len);
+	LLVMFuzzerTestOneInput(buf, len);
+	free(buf);
+
+	return 0;
+}
+
+static size_t generate(u64 *state, u8 *buf, size_t cap)
+{
+	u8 payload[512];
+	size_t len = 2;
+	u64 r;
+
+	rand_fill(state, buf, 2);
+
+	while (len < cap) {
+		r = rand_next(state);
+
+		switch (r % 8) {
+		case 0:
+		case 1:
+		case 2:
+		case 3: {
+			u16 plen = (r >> 8) % sizeof(payload);
+
+			if (cap - len < SSH_COMMAND_MESSAGE_LENGTH(plen))
+				return len;
+
+			rand_fill(state, payload, plen);
+			len += build_cmd(buf + len, cap - len, r >> 24, r >> 32,
+					 payload, plen);
+			break;
+		}
+
+		case 4: {
+			struct msgbuf msgb;
+
+			if (cap - len < SSH_MSG_LEN_CTRL)
+				return len;
+
+			msgb_init(&msgb, buf + len, cap - len);
+			if (r & BIT(8))
+				msgb_push_ack(&msgb, r >> 16);
+			else
+				msgb_push_nak(&msgb);
+
+			len += msgb_bytes_used(&msgb);
+			break;
+		}
+
+		case 5:
+			buf[len++] = SSH_MSG_SYN & 0xff;
+			break;
+
+		case 6: {
+			size_t n = min_t(size_t, (r >> 8) % 64, cap - len);
+
+			rand_fill(state, buf + len, n);
+			len += n;
+			break;
+		}
+
+		case 7:
+			/* Stop here, possibly leaving an incomplete message. */
+			if ((r >> 8) % 8 == 0)
+				return len;
+			break;
+		}
+	}
+
+	return len;
+}
+
+static void mutate(u64 *state, u8 *buf, size_t len)
+{
+	unsigned int n = rand_next(state) % 4;
+
+	while (len > 2 && n--) {
+		u64 r = rand_next(state);
+
+		buf[2 + (r >> 8) % (len - 2)] ^= BIT(r % 8);
+	}
+}
+
+static void run_random(u64 seed, unsigned long runs)
+{
+	u64 state = seed ?: 1;
+	unsigned long i;
+	size_t len;
+	u8 *buf;
+
+	for (i = 0; i < runs; i++) {
+		len = generate(&state, input, 2 + rand_next(&state) % (sizeof(input) - 2));
+		mutate(&state, input, len);
+
+		buf = malloc(len);
+		memcpy(buf, input, len);
+		LLVMFuzzerTestOneInput(buf, len);
+		free(buf);
+	}
+
+	printf("%lu runs, seed %llu: ok\n", runs, (unsigned long long)seed);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long runs = 10000;
+	unsigned long long seed = 1;
+	int files = 0;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "-runs=", 6))
+			runs = strtoul(argv[i] + 6, NULL, 10);
+		else if (!strncmp(argv[i], "-seed=", 6))
+			seed = strtoull(argv[i] + 6, NULL, 10);
+		else if (run_file(argv[i]))
+			return 1;
+		else
+			files++;
+	}
+
+	if (!files)
+		run_random(seed, runs);
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Fuzz target for the SSH frame parser.
+ *
+ * The first two bytes of the input select how the remaining data is received:
+ * The position at which the receive buffer wraps around, and the size of the
+ * chunks in which data arrives. The remaining data is then processed message
+ * by message, the same way the packet layer does, and checked against a
+ * one-shot parse of the same data and against simple reference
+ * implementations.
+ */
+
+#include "fuzz.h"
+#include "util.h"
+
+#include "../module/src/ssh_crc.h"
+
+static size_t chunks[RX_MAX_MSG_LEN];
+
+/* Bytewise reference for sshp_find_syn(), see there for the semantics. */
+static bool ref_find_syn(const u8 *buf, size_t len, size_t *offset)
+{
+	size_t i;
+
+	for (i = 0; i + 1 < len; i++) {
+		if (buf[i] == (SSH_MSG_SYN & 0xff) && buf[i + 1] == (SSH_MSG_SYN >> 8)) {
+			*offset = i;
+			return true;
+		}
+	}
+
+	if (buf[len - 1] == (SSH_MSG_SYN & 0xff))
+		*offset = len - 1;
+	else
+		*offset = len;
+
+	return false;
+}
+
+static void check_find_syn(const u8 *buf, size_t len, size_t split)
+{
+	struct ssam_span src = { (u8 *)buf, len };
+	struct ssam_span first, second, rem;
+	size_t ref, offset;
+	bool found;
+
+	found = ref_find_syn(buf, len, &ref);
+
+	FUZZ_ASSERT(sshp_find_syn(&src, &rem) == found);
+	FUZZ_ASSERT(rem.ptr == buf + ref);
+	FUZZ_ASSERT(rem.len == len - ref);
+
+	/* The first segment must not be empty. */
+	first.ptr = (u8 *)buf;
+	first.len = max_t(size_t, 1, min(split, len));
+	second.ptr = first.ptr + first.len;
+	second.len = len - first.len;
+
+	FUZZ_ASSERT(sshp_find_syn_wrapped(&first, &second, &offset) == found);
+	FUZZ_ASSERT(offset == ref);
+}
+
+static void check_message(const struct rx_result *res)
+{
+	struct ssh_command *cmd;
+	struct ssam_span data;
+	u16 crc;
+	int status;
+
+	FUZZ_ASSERT(res->payload.len == get_unaligned_le16(&res->frame->len));
+	FUZZ_ASSERT(res->msg_len == SSH_MESSAGE_LENGTH(res->payload.len));
+
+	crc = get_unaligned_le16(res->payload.ptr + res->payload.len);
+	FUZZ_ASSERT(crc == ssh_crc_compute(res->payload.ptr, res->payload.len));
+
+	if (res->frame->type != SSH_FRAME_TYPE_DATA_SEQ &&
+	    res->frame->type != SSH_FRAME_TYPE_DATA_NSQ)
+		return;
+
+	status = sshp_parse_command(&test_dev, &res->payload, &cmd, &data);
+	if (status) {
+		FUZZ_ASSERT(status == -ENOMSG);
+		FUZZ_ASSERT(res->payload.len < sizeof(struct ssh_command));
+		return;
+	}
+
+	FUZZ_ASSERT((u8 *)cmd == res->payload.ptr);
+	FUZZ_ASSERT(data.ptr == res->payload.ptr + sizeof(struct ssh_command));
+	FUZZ_ASSERT(data.len == res->payload.len - sizeof(struct ssh_command));
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static bool initialized;
+	struct rx_result ref, res;
+	struct ssam_span src;
+	size_t split, chunk, pos = 0;
+	size_t i;
+	int n, m;
+
+	if (!initialized) {
+		ssh_crc_init();
+		initialized = true;
+	}
+
+	if (size < 3)
+		return 0;
+
+	split = data[0];
+	chunk = data[1] % 64 + 1;
+	data += 2;
+	size -= 2;
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++)
+		chunks[i] = chunk;
+
+	check_find_syn(data, size, split);
+
+	while (pos < size) {
+		src.ptr = (u8 *)data + pos;
+		src.len = size - pos;
+
+		n = rx_one(&src, src.len, NULL, 0, &ref);
+		m = rx_one(&src, split, chunks, ARRAY_SIZE(chunks), &res);
+
+		/* Parsing must not depend on how the data has been received. */
+		FUZZ_ASSERT(n == m);
+		FUZZ_ASSERT(res.status == ref.status);
+		FUZZ_ASSERT(res.offset == ref.offset);
+		FUZZ_ASSERT(res.msg_len == ref.msg_len);
+		FUZZ_ASSERT(res.frame == ref.frame);
+		FUZZ_ASSERT(res.payload.ptr == ref.payload.ptr);
+		FUZZ_ASSERT(res.payload.len == ref.payload.len);
+
+		if (!res.status)
+			check_message(&res);
+
+		if (res.status == -ENOENT || res.status == -EAGAIN)
+			break;
+
+		FUZZ_ASSERT(n > 0 && (size_t)n <= src.len);
+		pos += n;
+	}
+
+	return 0;
+}
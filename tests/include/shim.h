@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal userspace shims for kernel types and helpers used by the module
+ * code under test.
+ *
+ * Only what is needed to compile and run those parts of the module in
+ * userspace is provided here. Functions that are only referenced by unused
+ * static inline functions of the module headers are declared but not
+ * defined.
+ */
+
+#ifndef _SSAM_TESTS_SHIM_H
+#define _SSAM_TESTS_SHIM_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* -- Types. ---------------------------------------------------------------- */
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef u16 __le16;
+typedef u32 __le32;
+typedef unsigned int gfp_t;
+typedef s64 ktime_t;
+
+#define GFP_KERNEL	0u
+#define GFP_ATOMIC	1u
+
+#define U8_MAX		((u8)~0u)
+#define U16_MAX		((u16)~0u)
+
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+struct hlist_node {
+	struct hlist_node *next, **pprev;
+};
+
+struct kref {
+	int refcount;
+};
+
+struct completion {
+	int done;
+};
+
+struct device {
+	const char *name;
+};
+
+typedef struct mempool mempool_t;
+struct kmem_cache;
+
+/* -- Compiler. ------------------------------------------------------------- */
+
+#define __packed		__attribute__((packed))
+#define __aligned(x)		__attribute__((aligned(x)))
+#define __ro_after_init
+#define __must_check		__attribute__((warn_unused_result))
+
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define READ_ONCE(x)		(*(const volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, v)	(*(volatile typeof(x) *)&(x) = (v))
+
+#define smp_load_acquire(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+#define static_assert(expr, ...)	__static_assert(expr, ##__VA_ARGS__, #expr)
+#define __static_assert(expr, msg, ...)	_Static_assert(expr, msg)
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define WARN_ON(cond)		({ bool __c = !!(cond); if (__c) fprintf(stderr, "WARNING: %s:%d\n", __FILE__, __LINE__); __c; })
+
+/* -- Math. ----------------------------------------------------------------- */
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		min((t)(a), (t)(b))
+#define max_t(t, a, b)		max((t)(a), (t)(b))
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	clamp((t)(v), (t)(lo), (t)(hi))
+
+static inline bool is_power_of_2(unsigned long n)
+{
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+/* -- Bit operations. ------------------------------------------------------- */
+
+#define BITS_PER_LONG		(sizeof(long) * CHAR_BIT)
+#define BIT(n)			(1ul << (n))
+#define BIT_WORD(n)		((n) / BITS_PER_LONG)
+#define BIT_MASK(n)		(1ul << ((n) % BITS_PER_LONG))
+#define BITS_TO_LONGS(n)	(((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits)	unsigned long name[BITS_TO_LONGS(bits)]
+
+static inline unsigned long __ffs64(u64 w)
+{
+	return __builtin_ctzll(w);
+}
+
+static inline void __set_bit(unsigned int nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline bool test_bit(unsigned int nr, const unsigned long *addr)
+{
+	return addr[BIT_WORD(nr)] & BIT_MASK(nr);
+}
+
+static inline void bitmap_zero(unsigned long *map, unsigned int nbits)
+{
+	memset(map, 0, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+static inline void bitmap_clear(unsigned long *map, unsigned int start,
+				unsigned int len)
+{
+	while (len--) {
+		map[BIT_WORD(start)] &= ~BIT_MASK(start);
+		start++;
+	}
+}
+
+/* -- Unaligned access. ----------------------------------------------------- */
+
+static inline u16 get_unaligned_le16(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8;
+}
+
+static inline u32 get_unaligned_le32(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8 | b[2] << 16 | (u32)b[3] << 24;
+}
+
+static inline u64 get_unaligned_le64(const void *p)
+{
+	return get_unaligned_le32(p) | (u64)get_unaligned_le32((const u8 *)p + 4) << 32;
+}
+
+static inline void put_unaligned_le16(u16 v, void *p)
+{
+	u8 *b = p;
+
+	b[0] = v;
+	b[1] = v >> 8;
+}
+
+static inline void put_unaligned_le32(u32 v, void *p)
+{
+	put_unaligned_le16(v, p);
+	put_unaligned_le16(v >> 16, (u8 *)p + 2);
+}
+
+#define cpu_to_le16(x)		((__le16)(x))
+#define le16_to_cpu(x)		((u16)(x))
+
+/* -- Memory. --------------------------------------------------------------- */
+
+static inline void *kzalloc(size_t size, gfp_t flags)
+{
+	(void)flags;
+	return calloc(1, size);
+}
+
+static inline void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+/* -- Logging. -------------------------------------------------------------- */
+
+extern bool shim_log_enabled;
+
+#define shim_log(lvl, dev, fmt, ...)					\
+	do {								\
+		if (shim_log_enabled)					\
+			fprintf(stderr, lvl "%s: " fmt,			\
+				(dev) ? (dev)->name : "(null)",		\
+				##__VA_ARGS__);				\
+	} while (0)
+
+#define dev_dbg(dev, fmt, ...)	do { (void)(dev); } while (0)
+#define dev_info(dev, fmt, ...)	shim_log("info: ", dev, fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...)	shim_log("warn: ", dev, fmt, ##__VA_ARGS__)
+#define dev_err(dev, fmt, ...)	shim_log("err: ", dev, fmt, ##__VA_ARGS__)
+
+/* -- CRC. ------------------------------------------------------------------ */
+
+u16 crc_ccitt_false(u16 crc, const u8 *buf, size_t len);
+
+/* -- Declarations only, referenced by unused inline functions. ------------- */
+
+void kref_get(struct kref *kref);
+int kref_put(struct kref *kref, void (*release)(struct kref *kref));
+void wait_for_completion(struct completion *x);
+
+#endif /* _SSAM_TESTS_SHIM_H */
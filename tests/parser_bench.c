@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for the SSH frame parser.
+ */
+
+#include "bench.h"
+#include "util.h"
+
+#include "../module/src/ssh_crc.h"
+
+struct rx_ctx {
+	struct ssam_span src;
+	size_t split;
+	const size_t *chunks;
+	size_t nchunks;
+};
+
+static u8 msg[RX_MAX_MSG_LEN];
+static u8 noise[RX_MAX_MSG_LEN];
+static size_t chunks[RX_MAX_MSG_LEN];
+
+static void bench_rx(void *ctx)
+{
+	struct rx_ctx *c = ctx;
+	struct rx_result res;
+
+	rx_one(&c->src, c->split, c->chunks, c->nchunks, &res);
+	bench_sink += res.payload.len;
+}
+
+static void parser_bench(void)
+{
+	static const u16 sizes[] = { 0, 8, 64, 256, 1024,
+				     RX_MAX_MSG_LEN - SSH_COMMAND_MESSAGE_LENGTH(0) };
+	struct rx_ctx ctx;
+	char name[64];
+	u64 seed = 1;
+	size_t i;
+
+	ssh_crc_init();
+	rand_fill(&seed, noise, sizeof(noise));
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++)
+		chunks[i] = 32;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		ctx.src.ptr = msg;
+		ctx.src.len = build_cmd(msg, sizeof(msg), 0x00, 0x0001, noise,
+					sizes[i]);
+
+		/* Complete message received at once. */
+		ctx.split = ctx.src.len;
+		ctx.chunks = NULL;
+		ctx.nchunks = 0;
+
+		snprintf(name, sizeof(name), "rx/payload=%u", sizes[i]);
+		bench_run(name, ctx.src.len, bench_rx, &ctx);
+
+		/* Message received in 32 byte chunks, wrapping in the middle. */
+		ctx.split = ctx.src.len / 2;
+		ctx.chunks = chunks;
+		ctx.nchunks = ARRAY_SIZE(chunks);
+
+		snprintf(name, sizeof(name), "rx/payload=%u/chunked", sizes[i]);
+		bench_run(name, ctx.src.len, bench_rx, &ctx);
+	}
+}
+
+BENCH_SUITE(parser, parser_bench)
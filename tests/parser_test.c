@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SSH frame parser and message builder.
+ */
+
+#include "test.h"
+#include "util.h"
+
+#include "../module/src/ssh_crc.h"
+
+static u8 msg[RX_MAX_MSG_LEN];
+static u8 payload[256];
+
+static void parser_init(void)
+{
+	u64 seed = 1;
+
+	ssh_crc_init();
+	rand_fill(&seed, payload, sizeof(payload));
+}
+
+static struct rx_result receive(const u8 *buf, size_t len)
+{
+	struct ssam_span src = { (u8 *)buf, len };
+	struct rx_result res;
+
+	rx_one(&src, len, NULL, 0, &res);
+	return res;
+}
+
+static void test_parse_command(void)
+{
+	struct ssh_command *cmd;
+	struct ssam_span data;
+	struct rx_result res;
+	size_t len;
+
+	len = build_cmd(msg, sizeof(msg), 0x42, 0x1234, payload, 16);
+	EXPECT_EQ(len, SSH_COMMAND_MESSAGE_LENGTH(16));
+
+	res = receive(msg, len);
+	EXPECT_EQ(res.status, 0);
+	EXPECT_EQ(res.offset, 0);
+	EXPECT_EQ(res.msg_len, len);
+	if (res.status)
+		return;
+
+	EXPECT_EQ(res.frame->type, SSH_FRAME_TYPE_DATA_SEQ);
+	EXPECT_EQ(res.frame->seq, 0x42);
+	EXPECT_EQ(get_unaligned_le16(&res.frame->len), sizeof(struct ssh_command) + 16);
+
+	EXPECT_EQ(sshp_parse_command(&test_dev, &res.payload, &cmd, &data), 0);
+	EXPECT_EQ(cmd->type, SSH_PLD_TYPE_CMD);
+	EXPECT_EQ(cmd->tc, 0x02);
+	EXPECT_EQ(cmd->cid, 0x0d);
+	EXPECT_EQ(get_unaligned_le16(&cmd->rqid), 0x1234);
+	EXPECT_EQ(data.len, 16);
+	EXPECT(!memcmp(data.ptr, payload, 16));
+}
+
+static void test_parse_empty_payload(void)
+{
+	struct ssh_command *cmd;
+	struct ssam_span data;
+	struct rx_result res;
+	size_t len;
+
+	len = build_cmd(msg, sizeof(msg), 0x00, 0x0001, payload, 0);
+
+	res = receive(msg, len);
+	EXPECT_EQ(res.status, 0);
+	if (res.status)
+		return;
+
+	EXPECT_EQ(sshp_parse_command(&test_dev, &res.payload, &cmd, &data), 0);
+	EXPECT_EQ(data.len, 0);
+}
+
+static void test_parse_ack(void)
+{
+	struct rx_result res;
+	struct msgbuf msgb;
+
+	msgb_init(&msgb, msg, sizeof(msg));
+	msgb_push_ack(&msgb, 0xff);
+	EXPECT_EQ(msgb_bytes_used(&msgb), SSH_MSG_LEN_CTRL);
+
+	res = receive(msg, msgb_bytes_used(&msgb));
+	EXPECT_EQ(res.status, 0);
+	if (res.status)
+		return;
+
+	EXPECT_EQ(res.frame->type, SSH_FRAME_TYPE_ACK);
+	EXPECT_EQ(res.frame->seq, 0xff);
+	EXPECT_EQ(res.payload.len, 0);
+}
+
+static void test_parse_chunked(void)
+{
+	struct rx_result ref, res;
+	struct ssam_span src;
+	size_t len, chunk, split;
+	size_t chunks[RX_MAX_MSG_LEN];
+	size_t i;
+
+	len = build_cmd(msg, sizeof(msg), 0x10, 0x0020, payload, 100);
+	ref = receive(msg, len);
+	EXPECT_EQ(ref.status, 0);
+
+	src.ptr = msg;
+	src.len = len;
+
+	/* Results must not depend on how the data is received. */
+	for (chunk = 1; chunk <= 16; chunk++) {
+		for (i = 0; i < ARRAY_SIZE(chunks); i++)
+			chunks[i] = chunk;
+
+		for (split = 0; split <= len; split += 7) {
+			rx_one(&src, split, chunks, ARRAY_SIZE(chunks), &res);
+
+			EXPECT_EQ(res.status, 0);
+			EXPECT_EQ(res.msg_len, ref.msg_len);
+			EXPECT_EQ(res.payload.len, ref.payload.len);
+		}
+	}
+}
+
+static void test_parse_leading_garbage(void)
+{
+	struct rx_result res;
+	size_t len;
+
+	/* Garbage without SYN bytes before the message. */
+	memset(msg, 0x11, 13);
+	len = 13 + build_cmd(msg + 13, sizeof(msg) - 13, 0x01, 0x0002, payload, 8);
+
+	res = receive(msg, len);
+	EXPECT_EQ(res.status, 0);
+	EXPECT_EQ(res.offset, 13);
+}
+
+static void test_parse_incomplete(void)
+{
+	struct rx_result res;
+	size_t len;
+
+	len = build_cmd(msg, sizeof(msg), 0x01, 0x0002, payload, 32);
+
+	/* Incomplete header. */
+	res = receive(msg, 5);
+	EXPECT_EQ(res.status, -EAGAIN);
+
+	/* Incomplete payload. */
+	res = receive(msg, len - 1);
+	EXPECT_EQ(res.status, -EAGAIN);
+}
+
+static void test_parse_bad_frame_crc(void)
+{
+	struct rx_result res;
+	size_t len;
+
+	len = build_cmd(msg, sizeof(msg), 0x01, 0x0002, payload, 32);
+	msg[SSH_MSGOFFSET_FRAME(seq)] ^= 0x01;
+
+	res = receive(msg, len);
+	EXPECT_EQ(res.status, -EBADMSG);
+}
+
+static void test_parse_bad_payload_crc(void)
+{
+	struct rx_result res;
+	size_t len;
+
+	len = build_cmd(msg, sizeof(msg), 0x01, 0x0002, payload, 32);
+	msg[len - 3] ^= 0x80;
+
+	res = receive(msg, len);
+	EXPECT_EQ(res.status, -EBADMSG);
+}
+
+static void test_parse_too_large(void)
+{
+	struct rx_result res;
+	struct msgbuf msgb;
+
+	msgb_init(&msgb, msg, sizeof(msg));
+	msgb_push_syn(&msgb);
+	msgb_push_frame(&msgb, SSH_FRAME_TYPE_DATA_SEQ, RX_MAX_MSG_LEN, 0x00);
+
+	res = receive(msg, msgb_bytes_used(&msgb));
+	EXPECT_EQ(res.status, -EMSGSIZE);
+}
+
+static void test_parse_command_too_short(void)
+{
+	struct ssh_command *cmd;
+	struct ssam_span data;
+	struct ssam_span src = { payload, sizeof(struct ssh_command) - 1 };
+
+	EXPECT_EQ(sshp_parse_command(&test_dev, &src, &cmd, &data), -ENOMSG);
+	EXPECT(!cmd);
+	EXPECT_EQ(data.len, 0);
+}
+
+TEST_SUITE(parser, parser_init,
+	TEST_CASE(test_parse_command),
+	TEST_CASE(test_parse_empty_payload),
+	TEST_CASE(test_parse_ack),
+	TEST_CASE(test_parse_chunked),
+	TEST_CASE(test_parse_leading_garbage),
+	TEST_CASE(test_parse_incomplete),
+	TEST_CASE(test_parse_bad_frame_crc),
+	TEST_CASE(test_parse_bad_payload_crc),
+	TEST_CASE(test_parse_too_large),
+	TEST_CASE(test_parse_command_too_short),
+)
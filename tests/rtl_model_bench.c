@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Model of the submit-to-wire latency of the request layer.
+ *
+ * This does not run any driver code. It models the ways a request can be
+ * transferred from the submitting context to the packet layer with plain
+ * threads, under a CPU-bound background load:
+ *
+ * - system-wq:  Via a work item on a worker shared with unrelated work, as
+ *               with schedule_work() on the system workqueue.
+ * - highpri-wq: Via a work item on a dedicated high-priority worker, as with
+ *               system_highpri_wq.
+ * - direct:     Directly from the submitting context if the transmitter lock
+ *               is not contended, falling back to the high-priority worker
+ *               otherwise, as done by ssh_rtl_tx_process().
+ *
+ * Latency is measured from submission until the request is handed to the
+ * simulated packet layer. The results therefore only show the scheduling
+ * latency inherent to each path on the host running the model, not the
+ * latency of the driver itself.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "util.h"
+
+#define WQ_LEN			1024
+#define MAX_SAMPLES		16384
+
+#define SUBMIT_INTERVAL_US	200
+#define BG_WORK_US		200
+#define BG_INTERVAL_US		400
+
+struct work {
+	void (*fn)(void *arg);
+	void *arg;
+};
+
+struct workqueue {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct work items[WQ_LEN];
+	unsigned int head, tail;
+	bool stop;
+	pthread_t thread;
+};
+
+static struct workqueue system_wq;
+static struct workqueue highpri_wq;
+
+static pthread_mutex_t tx_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool load_stop;
+
+static u64 submitted[MAX_SAMPLES];
+static u64 latency[MAX_SAMPLES];
+
+static void spin_us(u64 us)
+{
+	u64 end = bench_now_ns() + us * 1000;
+
+	while (bench_now_ns() < end)
+		;
+}
+
+static void sleep_us(u64 us)
+{
+	struct timespec ts = { .tv_nsec = us * 1000 };
+
+	nanosleep(&ts, NULL);
+}
+
+static void *wq_thread(void *arg)
+{
+	struct workqueue *wq = arg;
+	struct work w;
+
+	pthread_mutex_lock(&wq->lock);
+	while (true) {
+		while (wq->head == wq->tail && !wq->stop)
+			pthread_cond_wait(&wq->cond, &wq->lock);
+
+		if (wq->head == wq->tail)
+			break;
+
+		w = wq->items[wq->head++ % WQ_LEN];
+
+		pthread_mutex_unlock(&wq->lock);
+		w.fn(w.arg);
+		pthread_mutex_lock(&wq->lock);
+	}
+	pthread_mutex_unlock(&wq->lock);
+
+	return NULL;
+}
+
+static void *wq_thread_highpri(void *arg)
+{
+	/* Best effort, requires CAP_SYS_NICE. */
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), -20);
+
+	return wq_thread(arg);
+}
+
+static void wq_start(struct workqueue *wq, void *(*fn)(void *))
+{
+	pthread_mutex_init(&wq->lock, NULL);
+	pthread_cond_init(&wq->cond, NULL);
+	wq->head = wq->tail = 0;
+	wq->stop = false;
+
+	pthread_create(&wq->thread, NULL, fn, wq);
+}
+
+static void wq_stop(struct workqueue *wq)
+{
+	pthread_mutex_lock(&wq->lock);
+	wq->stop = true;
+	pthread_cond_signal(&wq->cond);
+	pthread_mutex_unlock(&wq->lock);
+
+	pthread_join(wq->thread, NULL);
+}
+
+static bool queue_work(struct workqueue *wq, void (*fn)(void *arg), void *arg)
+{
+	bool queued = false;
+
+	pthread_mutex_lock(&wq->lock);
+	if (wq->tail - wq->head < WQ_LEN) {
+		wq->items[wq->tail++ % WQ_LEN] = (struct work){ fn, arg };
+		pthread_cond_signal(&wq->cond);
+		queued = true;
+	}
+	pthread_mutex_unlock(&wq->lock);
+
+	return queued;
+}
+
+/* Hand the request over to the packet layer, i.e. record its latency. */
+static void transmit(size_t i)
+{
+	u64 ns = max_t(u64, bench_now_ns() - submitted[i], 1);
+
+	__atomic_store_n(&latency[i], ns, __ATOMIC_RELEASE);
+}
+
+static void tx_work_fn(void *arg)
+{
+	pthread_mutex_lock(&tx_lock);
+	transmit((size_t)arg);
+	pthread_mutex_unlock(&tx_lock);
+}
+
+static void bg_work_fn(void *arg)
+{
+	(void)arg;
+	spin_us(BG_WORK_US);
+}
+
+static void *bg_submit_thread(void *arg)
+{
+	(void)arg;
+
+	while (!load_stop) {
+		queue_work(&system_wq, bg_work_fn, NULL);
+		sleep_us(BG_INTERVAL_US);
+	}
+
+	return NULL;
+}
+
+static void *load_thread(void *arg)
+{
+	(void)arg;
+
+	while (!load_stop)
+		bench_sink++;
+
+	return NULL;
+}
+
+enum submit_mode {
+	SUBMIT_SYSTEM_WQ,
+	SUBMIT_HIGHPRI_WQ,
+	SUBMIT_DIRECT,
+};
+
+static void submit(enum submit_mode mode, size_t i)
+{
+	submitted[i] = bench_now_ns();
+
+	switch (mode) {
+	case SUBMIT_SYSTEM_WQ:
+		queue_work(&system_wq, tx_work_fn, (void *)i);
+		break;
+
+	case SUBMIT_HIGHPRI_WQ:
+		queue_work(&highpri_wq, tx_work_fn, (void *)i);
+		break;
+
+	case SUBMIT_DIRECT:
+		if (pthread_mutex_trylock(&tx_lock)) {
+			queue_work(&highpri_wq, tx_work_fn, (void *)i);
+			break;
+		}
+
+		transmit(i);
+		pthread_mutex_unlock(&tx_lock);
+		break;
+	}
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run(const char *name, enum submit_mode mode)
+{
+	u64 start, sum = 0;
+	size_t i, n = 0;
+
+	start = bench_now_ns();
+	while (n < MAX_SAMPLES && bench_now_ns() - start < bench_duration_ns()) {
+		latency[n] = 0;
+		submit(mode, n++);
+		sleep_us(SUBMIT_INTERVAL_US);
+	}
+
+	/* Wait for all outstanding requests. */
+	for (i = 0; i < n; i++) {
+		while (!__atomic_load_n(&latency[i], __ATOMIC_ACQUIRE))
+			sleep_us(100);
+	}
+
+	for (i = 0; i < n; i++)
+		sum += latency[i];
+
+	qsort(latency, n, sizeof(latency[0]), cmp_u64);
+
+	printf("  %-40s %8.1f us avg %8.1f us p50 %8.1f us p99 %8.1f us max (%zu requests)\n",
+	       name, sum / 1000.0 / n, latency[n / 2] / 1000.0,
+	       latency[n * 99 / 100] / 1000.0, latency[n - 1] / 1000.0, n);
+}
+
+static void rtl_model_bench(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t *load;
+	pthread_t bg;
+	long i;
+
+	load = calloc(ncpus, sizeof(*load));
+
+	wq_start(&system_wq, wq_thread);
+	wq_start(&highpri_wq, wq_thread_highpri);
+
+	load_stop = false;
+	pthread_create(&bg, NULL, bg_submit_thread, NULL);
+	for (i = 0; i < ncpus; i++)
+		pthread_create(&load[i], NULL, load_thread, NULL);
+
+	run("model/system-wq", SUBMIT_SYSTEM_WQ);
+	run("model/highpri-wq", SUBMIT_HIGHPRI_WQ);
+	run("model/direct", SUBMIT_DIRECT);
+
+	load_stop = true;
+	pthread_join(bg, NULL);
+	for (i = 0; i < ncpus; i++)
+		pthread_join(load[i], NULL);
+
+	wq_stop(&system_wq);
+	wq_stop(&highpri_wq);
+
+	free(load);
+}
+
+BENCH_SUITE(rtl_model, rtl_model_bench)
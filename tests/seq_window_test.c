@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the sequence ID window used for retransmission detection.
+ */
+
+#include "test.h"
+#include "util.h"
+
+#include "../module/src/ssh_seq_window.h"
+
+static struct ssh_seq_window w;
+
+/* Count blocked sequence IDs. */
+static unsigned int blocked(const struct ssh_seq_window *w)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i <= U8_MAX; i++)
+		n += ssh_seq_window_test(w, i);
+
+	return n;
+}
+
+static void test_seq_window_empty(void)
+{
+	ssh_seq_window_init(&w, 8);
+	EXPECT_EQ(blocked(&w), 0);
+}
+
+static void test_seq_window_block(void)
+{
+	unsigned int i;
+
+	ssh_seq_window_init(&w, 8);
+
+	for (i = 0x10; i < 0x18; i++)
+		ssh_seq_window_block(&w, i);
+
+	EXPECT_EQ(blocked(&w), 8);
+	for (i = 0x10; i < 0x18; i++)
+		EXPECT(ssh_seq_window_test(&w, i));
+
+	/* Moving on releases the oldest sequence ID. */
+	ssh_seq_window_block(&w, 0x18);
+	EXPECT_EQ(blocked(&w), 8);
+	EXPECT(!ssh_seq_window_test(&w, 0x10));
+	EXPECT(ssh_seq_window_test(&w, 0x11));
+	EXPECT(ssh_seq_window_test(&w, 0x18));
+}
+
+static void test_seq_window_wrap(void)
+{
+	unsigned int i;
+
+	ssh_seq_window_init(&w, 8);
+
+	for (i = 0xfc; i <= 0xff; i++)
+		ssh_seq_window_block(&w, i);
+
+	/* Wrap around from 0xff to 0x00, the window now covers both ends. */
+	ssh_seq_window_block(&w, 0x00);
+	ssh_seq_window_block(&w, 0x01);
+
+	EXPECT_EQ(blocked(&w), 6);
+	EXPECT(ssh_seq_window_test(&w, 0xfc));
+	EXPECT(ssh_seq_window_test(&w, 0xff));
+	EXPECT(ssh_seq_window_test(&w, 0x00));
+	EXPECT(ssh_seq_window_test(&w, 0x01));
+	EXPECT(!ssh_seq_window_test(&w, 0x02));
+	EXPECT(!ssh_seq_window_test(&w, 0xfb));
+
+	/* Slide the window past the wrap-around. */
+	for (i = 0x02; i <= 0x05; i++)
+		ssh_seq_window_block(&w, i);
+
+	EXPECT_EQ(blocked(&w), 8);
+	EXPECT(!ssh_seq_window_test(&w, 0xfd));
+	EXPECT(ssh_seq_window_test(&w, 0xfe));
+	EXPECT(ssh_seq_window_test(&w, 0xff));
+	EXPECT(ssh_seq_window_test(&w, 0x05));
+
+	ssh_seq_window_block(&w, 0x07);
+	EXPECT(!ssh_seq_window_test(&w, 0xff));
+	EXPECT(ssh_seq_window_test(&w, 0x00));
+}
+
+static void test_seq_window_wrap_duplicate(void)
+{
+	unsigned int i;
+
+	ssh_seq_window_init(&w, 8);
+
+	for (i = 0xf8; i <= 0x103; i++)
+		ssh_seq_window_block(&w, i & 0xff);
+
+	/* Re-transmissions of packets from before the wrap-around. */
+	EXPECT(!ssh_seq_window_test(&w, 0xfb));
+	EXPECT(ssh_seq_window_test(&w, 0xfc));
+	EXPECT(ssh_seq_window_test(&w, 0xff));
+
+	/* Re-transmissions of packets from after the wrap-around. */
+	EXPECT(ssh_seq_window_test(&w, 0x00));
+	EXPECT(ssh_seq_window_test(&w, 0x03));
+
+	/* New packets. */
+	EXPECT(!ssh_seq_window_test(&w, 0x04));
+	EXPECT(!ssh_seq_window_test(&w, 0x80));
+
+	/* The next packet releases the oldest one from before the wrap. */
+	ssh_seq_window_block(&w, 0x04);
+	EXPECT_EQ(blocked(&w), 8);
+	EXPECT(!ssh_seq_window_test(&w, 0xfc));
+	EXPECT(ssh_seq_window_test(&w, 0xfd));
+}
+
+static void test_seq_window_out_of_order(void)
+{
+	unsigned int i;
+
+	ssh_seq_window_init(&w, 8);
+
+	/* Lose 0x11 and 0x12, receive the following ones. */
+	ssh_seq_window_block(&w, 0x10);
+	for (i = 0x13; i < 0x17; i++)
+		ssh_seq_window_block(&w, i);
+
+	EXPECT(!ssh_seq_window_test(&w, 0x11));
+	EXPECT(!ssh_seq_window_test(&w, 0x12));
+
+	/* Late re-transmissions must not release the newer sequence IDs. */
+	ssh_seq_window_block(&w, 0x12);
+	ssh_seq_window_block(&w, 0x11);
+
+	EXPECT_EQ(blocked(&w), 7);
+	for (i = 0x10; i < 0x17; i++)
+		EXPECT(ssh_seq_window_test(&w, i));
+
+	/* Sequence IDs behind the window are not blocked. */
+	ssh_seq_window_block(&w, 0x0e);
+	EXPECT(!ssh_seq_window_test(&w, 0x0e));
+
+	/* The window keeps sliding from the newest sequence ID. */
+	ssh_seq_window_block(&w, 0x18);
+	EXPECT_EQ(blocked(&w), 7);
+	EXPECT(!ssh_seq_window_test(&w, 0x10));
+	EXPECT(ssh_seq_window_test(&w, 0x11));
+	EXPECT(!ssh_seq_window_test(&w, 0x17));
+	EXPECT(ssh_seq_window_test(&w, 0x18));
+}
+
+static void test_seq_window_sizes(void)
+{
+	static const unsigned int sizes[] = { 1, 2, 8, 16, 64, SSH_SEQ_WINDOW_MAX };
+	unsigned int i, seq, s;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		ssh_seq_window_init(&w, sizes[i]);
+
+		/* Run over multiple wrap-arounds. */
+		for (seq = 0; seq < 3 * (U8_MAX + 1); seq++) {
+			u8 last = seq & 0xff;
+
+			ssh_seq_window_block(&w, last);
+
+			for (s = 0; s <= U8_MAX; s++) {
+				unsigned int age = (u8)(last - s);
+				bool expected = age < sizes[i] && age <= seq;
+
+				if (ssh_seq_window_test(&w, s) != expected) {
+					EXPECT_EQ(ssh_seq_window_test(&w, s), expected);
+					return;
+				}
+			}
+		}
+	}
+}
+
+TEST_SUITE(seq_window, NULL,
+	TEST_CASE(test_seq_window_empty),
+	TEST_CASE(test_seq_window_block),
+	TEST_CASE(test_seq_window_wrap),
+	TEST_CASE(test_seq_window_wrap_duplicate),
+	TEST_CASE(test_seq_window_out_of_order),
+	TEST_CASE(test_seq_window_sizes),
+)
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Userspace implementations of kernel helpers used by the module code under
+ * test.
+ */
+
+#include "shim.h"
+
+bool shim_log_enabled;
+
+/*
+ * Reference bitwise CRC-CCITT implementation (MSB-first, polynomial 0x1021),
+ * equivalent to crc_ccitt_false() of the kernel.
+ */
+u16 crc_ccitt_false(u16 crc, const u8 *buf, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++ << 8;
+
+		for (i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+
+	return crc;
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Benchmarks for the SSH SYN byte search on noisy input, compared against a
+ * bytewise search.
+ */
+
+#include "bench.h"
+#include "util.h"
+
+#define SYN0	(SSH_MSG_SYN & 0xff)
+#define SYN1	(SSH_MSG_SYN >> 8)
+
+struct syn_ctx {
+	struct ssam_span src;
+	bool (*find)(const struct ssam_span *src, struct ssam_span *rem);
+};
+
+static u8 buf[RX_MAX_MSG_LEN];
+
+/* Bytewise search, testing every offset for the SYN bytes. */
+static bool find_syn_bytewise(const struct ssam_span *src, struct ssam_span *rem)
+{
+	size_t i;
+
+	for (i = 0; i < src->len - 1; i++) {
+		if (likely(get_unaligned_le16(src->ptr + i) == SSH_MSG_SYN)) {
+			rem->ptr = src->ptr + i;
+			rem->len = src->len - i;
+			return true;
+		}
+	}
+
+	if (unlikely(src->ptr[src->len - 1] == SYN0)) {
+		rem->ptr = src->ptr + src->len - 1;
+		rem->len = 1;
+		return false;
+	}
+
+	rem->ptr = src->ptr + src->len;
+	rem->len = 0;
+	return false;
+}
+
+static void bench_scan(void *ctx)
+{
+	struct syn_ctx *c = ctx;
+	struct ssam_span rem;
+
+	c->find(&c->src, &rem);
+	bench_sink += rem.len;
+}
+
+/*
+ * Resynchronization after invalid messages: Search for SYN bytes, skip them
+ * as the packet layer does on a parser error, and search again until the
+ * end of the data has been reached.
+ */
+static void bench_resync(void *ctx)
+{
+	struct syn_ctx *c = ctx;
+	struct ssam_span src = c->src;
+	struct ssam_span rem;
+
+	while (src.len > 2 && c->find(&src, &rem)) {
+		src.ptr = rem.ptr + 2;
+		src.len = rem.len - 2;
+		bench_sink++;
+	}
+}
+
+static void run(const char *input, size_t len, void (*fn)(void *ctx))
+{
+	struct syn_ctx ctx = { .src = { buf, len } };
+	char name[64];
+
+	ctx.find = find_syn_bytewise;
+	snprintf(name, sizeof(name), "bytewise/%s/len=%zu", input, len);
+	bench_run(name, len, fn, &ctx);
+
+	ctx.find = sshp_find_syn;
+	snprintf(name, sizeof(name), "swar/%s/len=%zu", input, len);
+	bench_run(name, len, fn, &ctx);
+}
+
+static void syn_bench(void)
+{
+	static const size_t sizes[] = { 16, 64, 256, RX_MAX_MSG_LEN };
+	u64 seed = 1;
+	size_t i;
+
+	/* Random line noise without any SYN bytes. */
+	rand_fill(&seed, buf, sizeof(buf));
+	for (i = 0; i < sizeof(buf); i++) {
+		if (buf[i] == SYN0)
+			buf[i] = 0x00;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		run("noise", sizes[i], bench_scan);
+
+	/* Noise with frequent first SYN bytes, but no complete SYN. */
+	for (i = 0; i < sizeof(buf); i += 4) {
+		buf[i] = SYN0;
+
+		if (buf[i + 1] == SYN1)
+			buf[i + 1] = 0x00;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		run("noise-syn0", sizes[i], bench_scan);
+
+	/* Noise with a complete SYN every 64 bytes on average. */
+	for (i = 0; i < sizeof(buf) - 1; i++) {
+		if (rand_next(&seed) % 64 == 0) {
+			buf[i] = SYN0;
+			buf[i + 1] = SYN1;
+		}
+	}
+
+	run("resync", RX_MAX_MSG_LEN, bench_resync);
+}
+
+BENCH_SUITE(syn, syn_bench)
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SSH SYN byte search.
+ */
+
+#include "test.h"
+#include "util.h"
+
+#define SYN0	(SSH_MSG_SYN & 0xff)
+#define SYN1	(SSH_MSG_SYN >> 8)
+
+static u8 buf[256];
+
+/* Fill buffer with noise not containing any SYN bytes. */
+static void fill_noise(u8 *p, size_t len, u64 *seed)
+{
+	size_t i;
+
+	rand_fill(seed, p, len);
+
+	for (i = 0; i < len; i++) {
+		if (p[i] == SYN0 || p[i] == SYN1)
+			p[i] = 0x00;
+	}
+}
+
+static bool find_syn(const u8 *p, size_t len, size_t *offset)
+{
+	struct ssam_span src = { (u8 *)p, len };
+	struct ssam_span rem;
+	bool found;
+
+	found = sshp_find_syn(&src, &rem);
+
+	/* The remaining span always extends to the end of the source. */
+	EXPECT(rem.ptr + rem.len == p + len);
+
+	*offset = rem.ptr - p;
+	return found;
+}
+
+static void test_syn_every_offset(void)
+{
+	size_t len, pos, offset;
+	u64 seed = 1;
+
+	for (len = 2; len <= 80; len++) {
+		for (pos = 0; pos + 2 <= len; pos++) {
+			fill_noise(buf, len, &seed);
+			buf[pos] = SYN0;
+			buf[pos + 1] = SYN1;
+
+			EXPECT(find_syn(buf, len, &offset));
+			EXPECT_EQ(offset, pos);
+		}
+	}
+}
+
+static void test_syn_first_match(void)
+{
+	size_t offset;
+	u64 seed = 2;
+
+	fill_noise(buf, 64, &seed);
+	buf[20] = SYN0;
+	buf[21] = SYN1;
+	buf[40] = SYN0;
+	buf[41] = SYN1;
+
+	EXPECT(find_syn(buf, 64, &offset));
+	EXPECT_EQ(offset, 20);
+}
+
+static void test_syn_none(void)
+{
+	size_t len, offset;
+	u64 seed = 3;
+
+	for (len = 1; len <= 80; len++) {
+		fill_noise(buf, len, &seed);
+
+		EXPECT(!find_syn(buf, len, &offset));
+		EXPECT_EQ(offset, len);
+	}
+}
+
+static void test_syn_partial_end(void)
+{
+	size_t len, offset;
+	u64 seed = 4;
+
+	/* A single first SYN byte at the end must be kept. */
+	for (len = 1; len <= 80; len++) {
+		fill_noise(buf, len, &seed);
+		buf[len - 1] = SYN0;
+
+		EXPECT(!find_syn(buf, len, &offset));
+		EXPECT_EQ(offset, len - 1);
+	}
+}
+
+static void test_syn_false_positives(void)
+{
+	static const u8 reversed[] = { SYN1, SYN0, 0x00 };
+	size_t len, offset;
+
+	/* Reversed SYN bytes. */
+	for (len = 1; len <= 80; len++) {
+		size_t i;
+
+		for (i = 0; i < len; i++)
+			buf[i] = reversed[i % ARRAY_SIZE(reversed)];
+		buf[len - 1] = 0x00;
+
+		EXPECT(!find_syn(buf, len, &offset));
+	}
+
+	/* Runs of the first SYN byte, followed by the second one. */
+	for (len = 2; len <= 80; len++) {
+		memset(buf, SYN0, len);
+		buf[len - 1] = SYN1;
+
+		EXPECT(find_syn(buf, len, &offset));
+		EXPECT_EQ(offset, len - 2);
+	}
+
+	/* Bytes with only the high bit differing from the SYN bytes. */
+	for (len = 2; len <= 80; len++) {
+		size_t i;
+
+		for (i = 0; i < len; i++)
+			buf[i] = i % 2 ? SYN1 ^ 0x80 : SYN0;
+		buf[len - 1] = 0x00;
+
+		EXPECT(!find_syn(buf, len, &offset));
+	}
+}
+
+static void test_syn_wrapped(void)
+{
+	struct ssam_span first, second;
+	size_t pos, split, offset;
+	const size_t len = 48;
+	u64 seed = 5;
+
+	/* SYN bytes at every position, with every split of the data. */
+	for (pos = 0; pos + 2 <= len; pos++) {
+		for (split = 1; split <= len; split++) {
+			fill_noise(buf, len, &seed);
+			buf[pos] = SYN0;
+			buf[pos + 1] = SYN1;
+
+			first.ptr = buf;
+			first.len = split;
+			second.ptr = buf + split;
+			second.len = len - split;
+
+			EXPECT(sshp_find_syn_wrapped(&first, &second, &offset));
+			EXPECT_EQ(offset, pos);
+		}
+	}
+}
+
+TEST_SUITE(syn, NULL,
+	TEST_CASE(test_syn_every_offset),
+	TEST_CASE(test_syn_first_match),
+	TEST_CASE(test_syn_none),
+	TEST_CASE(test_syn_partial_end),
+	TEST_CASE(test_syn_false_positives),
+	TEST_CASE(test_syn_wrapped),
+)
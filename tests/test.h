@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal unit test framework.
+ *
+ * Test cases are grouped into suites, which register themselves on startup
+ * via TEST_SUITE(). Test cases report failures via the EXPECT macros and
+ * continue running.
+ */
+
+#ifndef _SSAM_TESTS_TEST_H
+#define _SSAM_TESTS_TEST_H
+
+#include <stdio.h>
+
+struct test_case {
+	const char *name;
+	void (*run)(void);
+};
+
+struct test_suite {
+	const char *name;
+	const struct test_case *cases;
+	unsigned int count;
+	void (*init)(void);
+	struct test_suite *next;
+};
+
+extern unsigned int test_failures;
+
+void test_suite_register(struct test_suite *suite);
+
+#define TEST_CASE(fn)	{ .name = #fn, .run = fn }
+
+#define TEST_SUITE(sname, sinit, ...)					\
+	static const struct test_case __##sname##_cases[] = {		\
+		__VA_ARGS__						\
+	};								\
+	static struct test_suite __##sname##_suite = {			\
+		.name = #sname,						\
+		.cases = __##sname##_cases,				\
+		.count = sizeof(__##sname##_cases)			\
+			 / sizeof(__##sname##_cases[0]),		\
+		.init = sinit,						\
+	};								\
+	static void __attribute__((constructor)) __##sname##_register(void) \
+	{								\
+		test_suite_register(&__##sname##_suite);		\
+	}
+
+#define EXPECT(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "  %s:%d: expected: %s\n",	\
+				__FILE__, __LINE__, #cond);		\
+			test_failures++;				\
+		}							\
+	} while (0)
+
+#define EXPECT_EQ(a, b)							\
+	do {								\
+		long long __a = (long long)(a);				\
+		long long __b = (long long)(b);				\
+									\
+		if (__a != __b) {					\
+			fprintf(stderr, "  %s:%d: expected: %s == %s (%lld != %lld)\n", \
+				__FILE__, __LINE__, #a, #b, __a, __b);	\
+			test_failures++;				\
+		}							\
+	} while (0)
+
+#endif /* _SSAM_TESTS_TEST_H */
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit test runner. Runs all registered test suites, or only those given on
+ * the command line.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "test.h"
+
+unsigned int test_failures;
+
+static struct test_suite *suites;
+
+void test_suite_register(struct test_suite *suite)
+{
+	struct test_suite **p = &suites;
+
+	/* Keep suites sorted by name for deterministic output. */
+	while (*p && strcmp((*p)->name, suite->name) < 0)
+		p = &(*p)->next;
+
+	suite->next = *p;
+	*p = suite;
+}
+
+static bool selected(const struct test_suite *suite, int argc, char **argv)
+{
+	int i;
+
+	if (argc < 2)
+		return true;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], suite->name))
+			return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char **argv)
+{
+	const struct test_suite *suite;
+	unsigned int failed_cases = 0;
+	unsigned int total = 0;
+	unsigned int i, before;
+
+	for (suite = suites; suite; suite = suite->next) {
+		if (!selected(suite, argc, argv))
+			continue;
+
+		if (suite->init)
+			suite->init();
+
+		for (i = 0; i < suite->count; i++) {
+			before = test_failures;
+			suite->cases[i].run();
+			total++;
+
+			if (test_failures != before) {
+				failed_cases++;
+				printf("FAIL %s.%s\n", suite->name, suite->cases[i].name);
+			} else {
+				printf("ok   %s.%s\n", suite->name, suite->cases[i].name);
+			}
+		}
+	}
+
+	printf("%u/%u test cases passed\n", total - failed_cases, total);
+	return failed_cases ? 1 : 0;
+}
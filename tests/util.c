@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Common helpers for tests, benchmarks, and fuzz targets.
+ */
+
+#include "util.h"
+
+const struct device test_dev = { .name = "ssam-test" };
+
+/* xorshift64* pseudo-random number generator, for reproducible inputs. */
+u64 rand_next(u64 *state)
+{
+	u64 x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545f4914f6cdd1dull;
+}
+
+void rand_fill(u64 *state, u8 *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand_next(state) >> 56;
+}
+
+/*
+ * Build a sequenced command message with the given payload, as it would be
+ * sent by the EC. Returns the length of the message.
+ */
+size_t build_cmd(u8 *buf, size_t cap, u8 seq, u16 rqid, const u8 *payload,
+		 u16 len)
+{
+	struct ssam_request rqst = {
+		.target_category = 0x02,
+		.target_id = 0x01,
+		.command_id = 0x0d,
+		.instance_id = 0x00,
+		.flags = 0,
+		.length = len,
+		.payload = payload,
+	};
+	struct msgbuf msgb;
+
+	msgb_init(&msgb, buf, cap);
+	msgb_push_cmd(&msgb, seq, rqid, &rqst);
+
+	return msgb_bytes_used(&msgb);
+}
+
+/*
+ * Receive a single message from the given input, the same way the packet
+ * layer does: Search for SYN bytes, feed the data to the incremental frame
+ * parser in the given chunks (as it would arrive on the serial device), and
+ * finally validate the complete message. Chunks are given as lengths,
+ * remaining data is fed in one go. The message data is passed to the parser
+ * as two segments, split at @split bytes after the start of the message, as
+ * if it were wrapping around the end of the receive ring buffer.
+ *
+ * Returns the number of bytes of the input that have been consumed, i.e.
+ * that can be dropped from the receive buffer afterwards. The result of
+ * parsing is stored in @res. If no SYN bytes could be found, @res->status is
+ * set to -ENOENT. If the message is incomplete, it is set to -EAGAIN.
+ */
+int rx_one(const struct ssam_span *src, size_t split, const size_t *chunks,
+	   size_t nchunks, struct rx_result *res)
+{
+	struct sshp_frame_parser parser;
+	struct ssam_span first, second;
+	struct ssam_span msg;
+	size_t avail, i = 0;
+	int status;
+
+	memset(res, 0, sizeof(*res));
+
+	if (!src->len) {
+		res->status = -ENOENT;
+		return 0;
+	}
+
+	if (!sshp_find_syn(src, &msg)) {
+		res->status = -ENOENT;
+		res->offset = msg.ptr - src->ptr;
+		return res->offset;
+	}
+
+	res->offset = msg.ptr - src->ptr;
+	sshp_frame_parser_reset(&parser);
+
+	avail = 0;
+	do {
+		size_t n = i < nchunks ? chunks[i++] : msg.len;
+
+		avail = min(msg.len, avail + n);
+
+		first.ptr = msg.ptr;
+		first.len = min(avail, split);
+		second.ptr = msg.ptr + first.len;
+		second.len = avail - first.len;
+
+		status = sshp_frame_parser_feed(&test_dev, &parser, &first,
+						&second, RX_MAX_MSG_LEN);
+	} while (!status && avail < msg.len);
+
+	if (status < 0) {
+		/* Invalid message: Skip the SYN bytes and resume search after. */
+		res->status = status;
+		return res->offset + 2;
+	}
+
+	if (!status) {
+		res->status = -EAGAIN;
+		return res->offset;
+	}
+
+	res->msg_len = status;
+	res->status = sshp_frame_parser_finish(&test_dev, &parser, &msg,
+					       &res->frame, &res->payload);
+	if (res->status)
+		return res->offset + 2;
+
+	return res->offset + res->msg_len;
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Common helpers for tests, benchmarks, and fuzz targets.
+ */
+
+#ifndef _SSAM_TESTS_UTIL_H
+#define _SSAM_TESTS_UTIL_H
+
+#include "shim.h"
+
+#include "../module/src/ssh_msgb.h"
+#include "../module/src/ssh_parser.h"
+
+/* Maximum message length accepted by the receiver, see SSH_PTL_RX_BUF_LEN. */
+#define RX_MAX_MSG_LEN		4096
+
+extern const struct device test_dev;
+
+/**
+ * struct rx_result - Result of receiving a single message.
+ * @status:  Status of the parser: Zero if a valid frame has been received,
+ *           the error returned by the parser otherwise.
+ * @offset:  Offset of the message, i.e. its SYN bytes, in the input.
+ * @msg_len: Length of the message. Only valid if a valid frame has been
+ *           received or its header has been validated.
+ * @frame:   The received frame, only valid if @status is zero.
+ * @payload: The frame payload, only valid if @status is zero.
+ */
+struct rx_result {
+	int status;
+	size_t offset;
+	size_t msg_len;
+	struct ssh_frame *frame;
+	struct ssam_span payload;
+};
+
+u64 rand_next(u64 *state);
+void rand_fill(u64 *state, u8 *buf, size_t len);
+
+size_t build_cmd(u8 *buf, size_t cap, u8 seq, u16 rqid, const u8 *payload,
+		 u16 len);
+
+int rx_one(const struct ssam_span *src, size_t split, const size_t *chunks,
+	   size_t nchunks, struct rx_result *res);
+
+#endif /* _SSAM_TESTS_UTIL_H */